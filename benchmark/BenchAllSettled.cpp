@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <ranges>
+#include <vector>
+#include "../include/Promise.h"
+#include "BenchUtility.h"
+
+static constexpr size_t Fanout = 10000;
+static constexpr size_t Rounds = 50;
+/** One in this many shards fails */
+static constexpr size_t FailureRate = 10;
+
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *ptr = std::malloc(size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+/** The workaround: a coroutine per promise that turns the outcome into a value */
+static JS::Promise<JS::Settled<int>> SettleAsync(JS::Promise<int> promise)
+{
+    JS::Settled<int> settled{};
+    try
+    {
+        settled.Fulfill(co_await promise);
+    }
+    catch (...)
+    {
+        settled.Reject(std::current_exception());
+    }
+    co_return settled;
+}
+
+/** Settle every shard after the combinator is attached, then consume the result */
+template <typename Combinator>
+static void Run(Combinator &&combinator)
+{
+    std::vector<JS::Promise<int>> shards(Fanout);
+    auto result = combinator(shards);
+    result.Then([](std::vector<JS::Settled<int>> outcomes)
+                { DoNotOptimize(outcomes.size()); });
+    /** Rejections share one exception, so both sides pay the same for creating it */
+    auto failure = std::make_exception_ptr(std::runtime_error("shard failed"));
+    for (size_t i = 0; i < Fanout; i++)
+    {
+        if (i % FailureRate == 0)
+        {
+            shards[i].Reject(failure);
+        }
+        else
+        {
+            shards[i].Resolve(static_cast<int>(i));
+        }
+    }
+}
+
+template <typename Combinator>
+static void Report(const char *name, Combinator &&combinator)
+{
+    allocations = 0;
+    Measure(name, Rounds, [&](size_t n)
+            {
+        for (size_t i = 0; i < n; i++)
+        {
+            Run(combinator);
+        } });
+    std::printf("%-48s %10.2f allocations per shard, its own promise included\n", "",
+                static_cast<double>(allocations) / (Rounds * Fanout));
+}
+
+int main()
+{
+    Report("Wrapper coroutines + All, 10k shards", [](auto &shards)
+           { return JS::Promise<JS::Settled<int>>::All(shards | std::views::transform(SettleAsync)); });
+    Report("AllSettled, 10k shards", [](auto &shards)
+           { return JS::Promise<int>::AllSettled(shards); });
+    return 0;
+}
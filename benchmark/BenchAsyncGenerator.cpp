@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "../include/AsyncGenerator.h"
+#include "BenchUtility.h"
+
+static constexpr size_t Count = 10000000;
+
+static JS::AsyncGenerator<int> ProduceAsync(int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        co_yield i;
+    }
+}
+
+static JS::AsyncGenerator<int> ProduceBoundedAsync(JS::GeneratorCapacity capacity, int count)
+{
+    (void)capacity;
+    for (int i = 0; i < count; i++)
+    {
+        co_yield i;
+    }
+}
+
+static JS::Promise<long> ConsumeAsync(JS::AsyncGenerator<int> generator)
+{
+    long sum = 0;
+    while (auto value = co_await generator.NextAsync())
+    {
+        sum += *value;
+    }
+    co_return sum;
+}
+
+/** A 16 byte record, where per element overhead dominates */
+struct Record
+{
+    int64_t key;
+    int64_t value;
+};
+
+static JS::AsyncGenerator<Record> ProduceRecordsAsync(JS::GeneratorCapacity capacity, size_t count, size_t batchSize)
+{
+    (void)capacity;
+    std::vector<Record> batch{};
+    for (size_t i = 0; i < count; i += batchSize)
+    {
+        if (batchSize == 1)
+        {
+            co_yield Record{static_cast<int64_t>(i), 1};
+            continue;
+        }
+        batch.clear();
+        for (size_t j = i; j < i + batchSize && j < count; j++)
+        {
+            batch.push_back(Record{static_cast<int64_t>(j), 1});
+        }
+        co_yield JS::Batch(batch);
+    }
+}
+
+static JS::Promise<int64_t> ConsumeRecordsAsync(JS::AsyncGenerator<Record> generator, size_t batchSize)
+{
+    int64_t sum = 0;
+    if (batchSize == 1)
+    {
+        while (auto record = co_await generator.NextAsync())
+        {
+            sum += record->value;
+        }
+        co_return sum;
+    }
+    std::vector<Record> batch{};
+    while (co_await generator.NextBatchAsync(batch, batchSize))
+    {
+        for (const auto &record : batch)
+        {
+            sum += record.value;
+        }
+    }
+    co_return sum;
+}
+
+static void Stream(const char *name, JS::AsyncGenerator<int> (*produce)(size_t))
+{
+    Measure(name, Count, [&](size_t n)
+            {
+        auto sum = ConsumeAsync(produce(n));
+        DoNotOptimize(sum); });
+}
+
+int main()
+{
+    /** The producer runs ahead and the consumer reads from the buffer */
+    Stream("10M ints, buffered then read", [](size_t n)
+           { return ProduceAsync(static_cast<int>(n)); });
+    Stream("10M ints, capacity 64", [](size_t n)
+           { return ProduceBoundedAsync(JS::GeneratorCapacity{64}, static_cast<int>(n)); });
+    /** The consumer waits first, every value is handed straight to it */
+    Measure("10M ints, fed to a waiting consumer", Count, [](size_t n)
+            {
+        JS::AsyncGenerator<int> generator{};
+        auto sum = ConsumeAsync(generator);
+        for (size_t i = 0; i < n; i++)
+        {
+            generator.Feed(static_cast<int>(i));
+        }
+        generator.Finish();
+        DoNotOptimize(sum); });
+
+    /** Batches on both sides, through a buffer bounded to a few batches */
+    for (size_t batchSize : {1, 16, 256})
+    {
+        char name[64];
+        std::snprintf(name, sizeof(name), "10M records, batches of %zu", batchSize);
+        Measure(name, Count, [&](size_t n)
+                {
+            auto sum = ConsumeRecordsAsync(ProduceRecordsAsync(JS::GeneratorCapacity{4 * batchSize}, n, batchSize), batchSize);
+            DoNotOptimize(sum); });
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <vector>
+#include "../include/Promise.h"
+#include "BenchUtility.h"
+
+static constexpr size_t PayloadSize = 1 << 20;
+static constexpr size_t Fanout = 64;
+static constexpr size_t Rounds = 20;
+
+static size_t copies = 0;
+static size_t moves = 0;
+
+/** A 1 MiB buffer that counts how often it is copied and moved */
+struct Payload
+{
+    std::vector<char> data;
+
+    Payload()
+        : data(PayloadSize)
+    {
+    }
+    Payload(const Payload &other)
+        : data(other.data)
+    {
+        copies++;
+    }
+    Payload(Payload &&other) noexcept
+        : data(std::move(other.data))
+    {
+        moves++;
+    }
+    Payload &operator=(const Payload &other)
+    {
+        data = other.data;
+        copies++;
+        return *this;
+    }
+    Payload &operator=(Payload &&other) noexcept
+    {
+        data = std::move(other.data);
+        moves++;
+        return *this;
+    }
+};
+
+template <typename F>
+static void Report(const char *name, F &&body)
+{
+    copies = 0;
+    moves = 0;
+    Measure(name, Rounds, [&](size_t n)
+            {
+        for (size_t i = 0; i < n; i++)
+        {
+            body();
+        } });
+    std::printf("%-48s %10.2f copies, %.2f moves per element\n", "",
+                static_cast<double>(copies) / (Rounds * Fanout),
+                static_cast<double>(moves) / (Rounds * Fanout));
+}
+
+/** Resolve every input after the combinator is attached, then consume the result */
+template <typename Combinator, typename Consume>
+static void Run(Combinator &&combinator, Consume &&consume)
+{
+    std::vector<JS::Promise<Payload>> promises(Fanout);
+    auto result = combinator(promises);
+    result.Then(std::forward<Consume>(consume));
+    for (auto &promise : promises)
+    {
+        promise.Resolve(Payload{});
+    }
+}
+
+int main()
+{
+    Report("All, 64 x 1 MiB per round", []
+           { Run([](auto &promises)
+                 { return JS::Promise<Payload>::All(promises); },
+                 [](std::vector<Payload> values)
+                 { DoNotOptimize(values.size()); }); });
+    Report("Any, 64 x 1 MiB per round", []
+           { Run([](auto &promises)
+                 { return JS::Promise<Payload>::Any(promises); },
+                 [](Payload value)
+                 { DoNotOptimize(value.data.size()); }); });
+    Report("Race, 64 x 1 MiB per round", []
+           { Run([](auto &promises)
+                 { return JS::Promise<Payload>::Race(promises); },
+                 [](Payload value)
+                 { DoNotOptimize(value.data.size()); }); });
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../include/EventLoop.h"
+#include "BenchUtility.h"
+#ifdef HAVE_TEV
+#include <tev-cpp/Tev.h>
+#endif
+
+static constexpr size_t Timers = 200000;
+static constexpr size_t Hops = 200000;
+static constexpr int MaxDelayMs = 20;
+
+static std::vector<int> RandomDelays()
+{
+    std::mt19937 random{42};
+    std::uniform_int_distribution<int> delay{0, MaxDelayMs};
+    std::vector<int> delays(Timers);
+    for (auto &ms : delays)
+    {
+        ms = delay(random);
+    }
+    return delays;
+}
+
+static JS::Promise<void> SleepAsync(JS::EventLoop &loop, int ms)
+{
+    co_await loop.Delay(ms);
+}
+
+static JS::Promise<void> HopAsync(JS::EventLoop &loop, size_t hops)
+{
+    for (size_t i = 0; i < hops; i++)
+    {
+        co_await loop.Delay(0);
+    }
+}
+
+int main()
+{
+    auto delays = RandomDelays();
+
+    Measure("EventLoop: 200k coroutines sleeping 0-20 ms", Timers, [&](size_t n)
+            {
+        JS::EventLoop loop{};
+        std::vector<JS::Promise<void>> sleepers{};
+        sleepers.reserve(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            sleepers.push_back(SleepAsync(loop, delays[i]));
+        }
+        loop.RunUntilComplete(JS::Promise<void>::All(sleepers)); });
+
+    Measure("EventLoop: set and clear a timeout", Timers, [&](size_t n)
+            {
+        JS::EventLoop loop{};
+        for (size_t i = 0; i < n; i++)
+        {
+            auto handle = loop.SetTimeout([]() {}, delays[i]);
+            loop.ClearTimeout(handle);
+        } });
+
+    Measure("EventLoop: one coroutine, 200k zero delays", Hops, [&](size_t n)
+            {
+        JS::EventLoop loop{};
+        loop.RunUntilComplete(HopAsync(loop, n)); });
+
+#ifdef HAVE_TEV
+    Measure("tev-cpp: 200k callbacks after 0-20 ms", Timers, [&](size_t n)
+            {
+        Tev tev{};
+        size_t fired = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            tev.SetTimeout([&]()
+                           { fired++; },
+                           delays[i]);
+        }
+        tev.MainLoop();
+        DoNotOptimize(fired); });
+
+    Measure("tev-cpp: set and clear a timeout", Timers, [&](size_t n)
+            {
+        Tev tev{};
+        for (size_t i = 0; i < n; i++)
+        {
+            auto handle = tev.SetTimeout([]() {}, delays[i]);
+            tev.ClearTimeout(handle);
+        } });
+#else
+    std::printf("tev-cpp not found, built without the comparison\n");
+#endif
+    return 0;
+}
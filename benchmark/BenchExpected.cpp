@@ -0,0 +1,90 @@
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+#include "../include/Expected.h"
+#include "BenchUtility.h"
+
+static constexpr size_t Failures = 200000;
+static constexpr size_t Fanout = 64;
+
+enum class Error
+{
+    Unavailable,
+};
+
+/** A downstream call that fails, two coroutines deep, the way a request handler sees it */
+static JS::Promise<int> QueryThrowingAsync()
+{
+    throw std::runtime_error("unavailable");
+    co_return 0;
+}
+
+static JS::Promise<int> HandleThrowingAsync()
+{
+    try
+    {
+        co_return co_await QueryThrowingAsync();
+    }
+    catch (const std::exception &)
+    {
+        co_return -1;
+    }
+}
+
+static JS::Promise<JS::Expected<int, Error>> QueryExpectedAsync()
+{
+    co_return JS::Unexpected{Error::Unavailable};
+}
+
+static JS::Promise<int> HandleExpectedAsync()
+{
+    auto result = co_await QueryExpectedAsync();
+    co_return result ? result.Value() : -1;
+}
+
+int main()
+{
+    Measure("Failure as exception, awaited", Failures, [](size_t n)
+            {
+        for (size_t i = 0; i < n; i++)
+        {
+            HandleThrowingAsync().Then([](int value)
+                                       { DoNotOptimize(value); });
+        } });
+    Measure("Failure as Expected, awaited", Failures, [](size_t n)
+            {
+        for (size_t i = 0; i < n; i++)
+        {
+            HandleExpectedAsync().Then([](int value)
+                                       { DoNotOptimize(value); });
+        } });
+
+    Measure("All over 64 failing promises", Failures / Fanout, [](size_t n)
+            {
+        auto failure = std::make_exception_ptr(std::runtime_error("unavailable"));
+        for (size_t i = 0; i < n; i++)
+        {
+            std::vector<JS::Promise<int>> promises(Fanout);
+            auto all = JS::Promise<int>::All(promises);
+            all.Catch([](const std::exception &e)
+                      { DoNotOptimize(e); });
+            for (auto &promise : promises)
+            {
+                promise.Reject(failure);
+            }
+        } });
+    Measure("AllExpected over 64 failing promises", Failures / Fanout, [](size_t n)
+            {
+        for (size_t i = 0; i < n; i++)
+        {
+            std::vector<JS::Promise<JS::Expected<int, Error>>> promises(Fanout);
+            auto all = JS::AllExpected(promises);
+            all.Then([](JS::Expected<std::vector<int>, Error> result)
+                     { DoNotOptimize(result.HasValue()); });
+            for (auto &promise : promises)
+            {
+                promise.Resolve(JS::Unexpected{Error::Unavailable});
+            }
+        } });
+    return 0;
+}
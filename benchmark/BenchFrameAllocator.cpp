@@ -0,0 +1,86 @@
+#include <vector>
+#include "../include/AsyncGenerator.h"
+#include "BenchUtility.h"
+
+static constexpr size_t Iterations = 5'000'000;
+
+static JS::Promise<int> ReturnAsync(int value)
+{
+    co_return value;
+}
+
+static JS::Promise<int> ReturnWithAllocatorAsync(std::allocator_arg_t, JS::FrameAllocator &, int value)
+{
+    co_return value;
+}
+
+static JS::Promise<int> AwaitChildAsync(int value)
+{
+    co_return co_await ReturnAsync(value) + 1;
+}
+
+/** Churn frames one at a time: create, finish, destroy */
+static void ChurnGlobal(size_t n)
+{
+    int sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        ReturnAsync(static_cast<int>(i)).Then([&](int v)
+                                              { sum += v; });
+    }
+    DoNotOptimize(sum);
+}
+
+static void ChurnNested(size_t n)
+{
+    int sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        AwaitChildAsync(static_cast<int>(i)).Then([&](int v)
+                                                  { sum += v; });
+    }
+    DoNotOptimize(sum);
+}
+
+static void ChurnExplicit(size_t n)
+{
+    JS::FramePool pool{};
+    int sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        ReturnWithAllocatorAsync(std::allocator_arg, pool, static_cast<int>(i)).Then([&](int v)
+                                                                                    { sum += v; });
+    }
+    DoNotOptimize(sum);
+}
+
+/** Keep many frames alive at once, then release them, to defeat malloc's own fast path */
+static void ChurnBatched(size_t n)
+{
+    std::vector<JS::Promise<int>> live{};
+    live.reserve(1024);
+    for (size_t i = 0; i < n; i += 1024)
+    {
+        for (size_t j = 0; j < 1024; j++)
+        {
+            live.push_back(ReturnAsync(static_cast<int>(j)));
+        }
+        live.clear();
+    }
+}
+
+int main()
+{
+    Measure("churn, global allocator", Iterations, ChurnGlobal);
+    Measure("nested churn, global allocator", Iterations, ChurnNested);
+    Measure("batched churn, global allocator", Iterations, ChurnBatched);
+    {
+        JS::FramePool pool{};
+        JS::ScopedFrameAllocator scope{pool};
+        Measure("churn, thread local FramePool", Iterations, ChurnGlobal);
+        Measure("nested churn, thread local FramePool", Iterations, ChurnNested);
+        Measure("batched churn, thread local FramePool", Iterations, ChurnBatched);
+    }
+    Measure("churn, explicit FramePool", Iterations, ChurnExplicit);
+    return 0;
+}
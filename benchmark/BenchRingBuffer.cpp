@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <queue>
+#include "../include/AsyncGenerator.h"
+#include "../include/RingBuffer.h"
+#include "BenchUtility.h"
+
+static constexpr size_t Count = 10000000;
+/** Values in flight in the steady state rounds, like a bounded generator */
+static constexpr size_t InFlight = 64;
+
+/** Push all, then pop all */
+template <typename Queue, typename Push, typename Pop>
+static void FillDrain(const char *name, Push &&push, Pop &&pop)
+{
+    Measure(name, Count, [&](size_t n)
+            {
+        Queue queue{};
+        for (size_t i = 0; i < n; i++)
+        {
+            push(queue, static_cast<int>(i));
+        }
+        long sum = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            sum += pop(queue);
+        }
+        DoNotOptimize(sum); });
+}
+
+/** Keep InFlight values queued, pushing one for every pop */
+template <typename Queue, typename Push, typename Pop>
+static void SteadyState(const char *name, Push &&push, Pop &&pop)
+{
+    Measure(name, Count, [&](size_t n)
+            {
+        Queue queue{};
+        for (size_t i = 0; i < InFlight; i++)
+        {
+            push(queue, static_cast<int>(i));
+        }
+        long sum = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            push(queue, static_cast<int>(i));
+            sum += pop(queue);
+        }
+        DoNotOptimize(sum); });
+}
+
+static JS::AsyncGenerator<int> ProduceAsync(int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        co_yield i;
+    }
+}
+
+static JS::AsyncGenerator<int> ProduceBoundedAsync(JS::GeneratorCapacity capacity, int count)
+{
+    (void)capacity;
+    for (int i = 0; i < count; i++)
+    {
+        co_yield i;
+    }
+}
+
+static JS::AsyncGenerator<int, void, InFlight> ProduceInlineAsync(int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        co_yield i;
+    }
+}
+
+template <typename Generator>
+static JS::Promise<long> ConsumeAsync(Generator generator)
+{
+    long sum = 0;
+    while (auto value = co_await generator.NextAsync())
+    {
+        sum += *value;
+    }
+    co_return sum;
+}
+
+int main()
+{
+    auto queuePush = [](std::queue<int> &queue, int value)
+    { queue.push(value); };
+    auto queuePop = [](std::queue<int> &queue)
+    {
+        int value = queue.front();
+        queue.pop();
+        return value;
+    };
+    auto ringPush = [](auto &ring, int value)
+    { ring.Push(value); };
+    auto ringPop = [](auto &ring)
+    {
+        int value = ring.Front();
+        ring.Pop();
+        return value;
+    };
+
+    FillDrain<std::queue<int>>("std::queue<int>, 10M push then pop", queuePush, queuePop);
+    FillDrain<JS::Detail::RingBuffer<int>>("RingBuffer<int>, 10M push then pop", ringPush, ringPop);
+    SteadyState<std::queue<int>>("std::queue<int>, 64 in flight", queuePush, queuePop);
+    SteadyState<JS::Detail::RingBuffer<int>>("RingBuffer<int>, 64 in flight", ringPush, ringPop);
+    SteadyState<JS::Detail::RingBuffer<int, 128>>("RingBuffer<int, 128> inline, 64 in flight", ringPush, ringPop);
+
+    Measure("AsyncGenerator<int>, 10M buffered then read", Count, [](size_t n)
+            {
+        auto sum = ConsumeAsync(ProduceAsync(static_cast<int>(n)));
+        DoNotOptimize(sum); });
+    Measure("AsyncGenerator<int>, capacity 64", Count, [](size_t n)
+            {
+        auto sum = ConsumeAsync(ProduceBoundedAsync(JS::GeneratorCapacity{InFlight}, static_cast<int>(n)));
+        DoNotOptimize(sum); });
+    Measure("AsyncGenerator<int, void, 64> inline", Count, [](size_t n)
+            {
+        auto sum = ConsumeAsync(ProduceInlineAsync(static_cast<int>(n)));
+        DoNotOptimize(sum); });
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "../include/EventLoop.h"
+#include "../include/Scheduler.h"
+#include "BenchUtility.h"
+
+static constexpr int FibN = 34;
+/** Below this the subtree is computed serially, so each task is a few microseconds of work */
+static constexpr int Cutoff = 16;
+
+static uint64_t Fib(int n)
+{
+    return n < 2 ? static_cast<uint64_t>(n) : Fib(n - 1) + Fib(n - 2);
+}
+
+static JS::Task<uint64_t> FibTask(JS::Scheduler &scheduler, int n)
+{
+    if (n < Cutoff)
+    {
+        co_return Fib(n);
+    }
+    auto left = scheduler.Spawn(FibTask(scheduler, n - 1));
+    uint64_t right = co_await FibTask(scheduler, n - 2);
+    co_return co_await left + right;
+}
+
+static JS::Promise<uint64_t> RootAsync(JS::Scheduler &scheduler)
+{
+    co_return co_await scheduler.Spawn(FibTask(scheduler, FibN));
+}
+
+int main()
+{
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    double baseline = 0;
+    for (size_t threads : {1, 2, 4, 8, 16})
+    {
+        JS::EventLoop loop{};
+        JS::Scheduler scheduler{threads};
+        JS::ScopedExecutor scope{loop};
+        auto start = std::chrono::steady_clock::now();
+        uint64_t result = loop.RunUntilComplete(RootAsync(scheduler));
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        DoNotOptimize(result);
+        baseline = threads == 1 ? ms : baseline;
+        std::printf("Scheduler: fib(%d), %2zu threads %28.2f ms  x%.2f\n", FibN, threads, ms, baseline / ms);
+    }
+    return 0;
+}
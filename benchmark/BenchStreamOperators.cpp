@@ -0,0 +1,93 @@
+#include <cstdint>
+#include <cstdio>
+#include "../include/AsyncGenerator.h"
+#include "../include/StreamOperators.h"
+#include "BenchUtility.h"
+
+static constexpr size_t Count = 10000000;
+
+static JS::AsyncGenerator<int> ProduceAsync(JS::GeneratorCapacity capacity, int count)
+{
+    (void)capacity;
+    for (int i = 0; i < count; i++)
+    {
+        co_yield i;
+    }
+}
+
+static int AddOne(int n)
+{
+    return n + 1;
+}
+
+static int Twice(int n)
+{
+    return n * 2;
+}
+
+static bool NotMultipleOfSeven(const int &n)
+{
+    return n % 7 != 0;
+}
+
+static bool NotMultipleOfFive(const int &n)
+{
+    return n % 5 != 0;
+}
+
+/** What a stage took before: a generator coroutine of its own */
+template <typename F>
+static JS::AsyncGenerator<int> MapAsync(JS::AsyncGenerator<int> source, F f)
+{
+    while (auto value = co_await source.NextAsync())
+    {
+        co_yield f(*value);
+    }
+}
+
+template <typename F>
+static JS::AsyncGenerator<int> FilterAsync(JS::AsyncGenerator<int> source, F f)
+{
+    while (auto value = co_await source.NextAsync())
+    {
+        if (f(*value))
+        {
+            co_yield *value;
+        }
+    }
+}
+
+static JS::Promise<int64_t> SumAsync(JS::AsyncGenerator<int> generator)
+{
+    int64_t sum = 0;
+    while (auto value = co_await generator.NextAsync())
+    {
+        sum += *value;
+    }
+    co_return sum;
+}
+
+int main()
+{
+    int64_t expected = 0;
+    /** Map, Filter, Map, Filter, Map over 10M ints, from a source bounded to 64 values */
+    Measure("5 stages, a coroutine per stage", Count, [&](size_t n)
+            {
+        auto source = ProduceAsync(JS::GeneratorCapacity{64}, static_cast<int>(n));
+        auto stages = MapAsync(FilterAsync(MapAsync(FilterAsync(MapAsync(source, AddOne), NotMultipleOfSeven), Twice), NotMultipleOfFive), AddOne);
+        /** Everything runs synchronously, the sum is there by now */
+        SumAsync(stages).Then([&](int64_t sum)
+                              { expected = sum; }); });
+    Measure("5 stages, fused", Count, [&](size_t n)
+            {
+        auto source = ProduceAsync(JS::GeneratorCapacity{64}, static_cast<int>(n));
+        JS::AsyncGenerator<int> stages = source | JS::Map(AddOne) | JS::Filter(NotMultipleOfSeven) | JS::Map(Twice) |
+                                         JS::Filter(NotMultipleOfFive) | JS::Map(AddOne);
+        SumAsync(stages).Then([&](int64_t sum)
+                              {
+            if (sum != expected)
+            {
+                std::printf("wrong sum\n");
+            } }); });
+    return 0;
+}
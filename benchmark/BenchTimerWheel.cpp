@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../include/Callback.h"
+#include "../include/TimerWheel.h"
+#include "BenchUtility.h"
+
+static constexpr size_t Timers = 1000000;
+/** Nine in ten timeouts are cleared, like request deadlines that are met */
+static constexpr size_t KeepOneIn = 10;
+static constexpr uint64_t MaxDelayMs = 60000;
+
+using Clock = JS::TimerWheel::Clock;
+
+/** What EventLoop used before: a binary heap, with cleared entries skipped when they reach the top */
+class HeapTimers
+{
+public:
+    uint64_t SetTimeout(JS::Callback<void()> callback, uint64_t ms, uint64_t now)
+    {
+        uint32_t slot{};
+        if (!_free.empty())
+        {
+            slot = _free.back();
+            _free.pop_back();
+        }
+        else
+        {
+            slot = static_cast<uint32_t>(_slots.size());
+            _slots.emplace_back();
+        }
+        auto &timer = _slots[slot];
+        timer.callback = std::move(callback);
+        timer.armed = true;
+        _heap.push_back(Entry{now + ms, _sequence++, slot, timer.generation});
+        std::push_heap(_heap.begin(), _heap.end(), Later{});
+        return (static_cast<uint64_t>(timer.generation) << 32) | slot;
+    }
+
+    void ClearTimeout(uint64_t handle)
+    {
+        uint32_t slot = static_cast<uint32_t>(handle);
+        if (_slots[slot].armed && _slots[slot].generation == static_cast<uint32_t>(handle >> 32))
+        {
+            Disarm(slot);
+        }
+    }
+
+    void Advance(uint64_t now)
+    {
+        while (!_heap.empty() && _heap.front().deadline <= now)
+        {
+            auto entry = _heap.front();
+            std::pop_heap(_heap.begin(), _heap.end(), Later{});
+            _heap.pop_back();
+            auto &timer = _slots[entry.slot];
+            if (!timer.armed || timer.generation != entry.generation)
+            {
+                continue;
+            }
+            auto callback = std::move(timer.callback);
+            Disarm(entry.slot);
+            callback();
+        }
+    }
+
+private:
+    struct Timer
+    {
+        JS::Callback<void()> callback{};
+        uint32_t generation{};
+        bool armed{};
+    };
+
+    struct Entry
+    {
+        uint64_t deadline;
+        uint64_t sequence;
+        uint32_t slot;
+        uint32_t generation;
+    };
+
+    struct Later
+    {
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            return a.deadline != b.deadline ? a.deadline > b.deadline : a.sequence > b.sequence;
+        }
+    };
+
+    void Disarm(uint32_t slot)
+    {
+        auto &timer = _slots[slot];
+        timer.armed = false;
+        timer.generation++;
+        timer.callback = nullptr;
+        _free.push_back(slot);
+    }
+
+    std::vector<Entry> _heap{};
+    std::vector<Timer> _slots{};
+    std::vector<uint32_t> _free{};
+    uint64_t _sequence{};
+};
+
+static std::vector<uint64_t> RandomDelays()
+{
+    std::mt19937 random{42};
+    std::uniform_int_distribution<uint64_t> delay{1, MaxDelayMs};
+    std::vector<uint64_t> delays(Timers);
+    for (auto &ms : delays)
+    {
+        ms = delay(random);
+    }
+    return delays;
+}
+
+/**
+ * Set all, clear nine in ten, then run the clock until the rest fired, one millisecond at a time.
+ * The second round reuses the storage the first one grew.
+ */
+template <typename Set, typename Clear, typename Advance>
+static void Run(const char *name, const std::vector<uint64_t> &delays, uint64_t round, Set &&set, Clear &&clear, Advance &&advance)
+{
+    std::vector<uint64_t> handles(Timers);
+    size_t fired = 0;
+    uint64_t base = round * MaxDelayMs;
+    std::printf("%s, %s\n", name, round == 0 ? "cold" : "warm");
+    Measure("  set 1M timeouts", Timers, [&](size_t n)
+            {
+        for (size_t i = 0; i < n; i++)
+        {
+            handles[i] = set([&fired]()
+                             { fired++; },
+                             delays[i], base);
+        } });
+    Measure("  clear 90%", Timers - Timers / KeepOneIn, [&](size_t)
+            {
+        for (size_t i = 0; i < Timers; i++)
+        {
+            if (i % KeepOneIn != 0)
+            {
+                clear(handles[i]);
+            }
+        } });
+    Measure("  advance 60 s, fire the other 10%", Timers / KeepOneIn, [&](size_t)
+            {
+        for (uint64_t ms = 1; ms <= MaxDelayMs; ms++)
+        {
+            advance(base + ms);
+        } });
+    DoNotOptimize(fired);
+    if (fired != Timers / KeepOneIn)
+    {
+        std::printf("  wrong count: %zu\n", fired);
+    }
+}
+
+int main()
+{
+    auto delays = RandomDelays();
+    auto start = Clock::now();
+
+    JS::TimerWheel wheel{start};
+    for (uint64_t round = 0; round < 2; round++)
+    {
+        Run(
+            "TimerWheel", delays, round,
+            [&](JS::Callback<void()> callback, uint64_t ms, uint64_t now)
+            { return wheel.SetTimeout(std::move(callback), ms, start + std::chrono::milliseconds(now)); },
+            [&](uint64_t handle)
+            { wheel.ClearTimeout(handle); },
+            [&](uint64_t now)
+            { wheel.Advance(start + std::chrono::milliseconds(now)); });
+    }
+    HeapTimers heap{};
+    for (uint64_t round = 0; round < 2; round++)
+    {
+        Run(
+            "Binary heap, lazy clear", delays, round,
+            [&](JS::Callback<void()> callback, uint64_t ms, uint64_t now)
+            { return heap.SetTimeout(std::move(callback), ms, now); },
+            [&](uint64_t handle)
+            { heap.ClearTimeout(handle); },
+            [&](uint64_t now)
+            { heap.Advance(now); });
+    }
+    return 0;
+}
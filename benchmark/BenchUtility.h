@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+/** Run body iterations times and print the average cost per iteration. */
+template <typename F>
+static double Measure(const char *name, size_t iterations, F &&body)
+{
+    auto start = std::chrono::steady_clock::now();
+    body(iterations);
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations);
+    std::printf("%-48s %10.2f ns/op\n", name, ns);
+    return ns;
+}
+
+/** Keep the optimizer from dropping a value. */
+template <typename T>
+static void DoNotOptimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
@@ -1,119 +1,341 @@
 #pragma once
 
+#include "Executor.h"
 #include "Promise.h"
-#include <queue>
+#include "RingBuffer.h"
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+/**
+ * A generator coroutine runs ahead of its consumer, buffering what it yields.
+ * Give it a GeneratorCapacity parameter to bound that buffer:
+ *
+ *   JS::AsyncGenerator<Chunk> ReadAsync(JS::GeneratorCapacity capacity, File &file);
+ *   auto chunks = ReadAsync(JS::GeneratorCapacity{4}, file);
+ *
+ * co_yield then suspends the producer while the buffer is full. Taking a value resumes it,
+ * through the current executor like any other resumption.
+ * A producer suspended this way stays suspended if its consumer stops reading.
+ *
+ * For small values, move them in bulk: co_yield JS::Batch(values) on the producer side, and
+ * NextBatchAsync on the consumer side, which takes everything buffered up to a count in one await.
+ *
+ * A power of two InlineCapacity, as in JS::AsyncGenerator<int, void, 64>, keeps the buffer inside
+ * the generator state instead of on the heap, and bounds a generator coroutine to it. A GeneratorCapacity
+ * may lower that bound, but not raise it. Feeding more than fits, by Feed or by one Batch, throws
+ * std::length_error.
+ */
 
 namespace JS
 {
-    template <typename T, typename R = void>
-    struct AsyncGenerator
+    /**
+     * @brief The most values a generator coroutine buffers before co_yield waits for the consumer.
+     */
+    struct GeneratorCapacity
+    {
+        explicit GeneratorCapacity(size_t value)
+            : value(value)
+        {
+            if (value == 0)
+            {
+                throw std::invalid_argument("Generator capacity must be at least 1");
+            }
+        }
+
+        size_t value;
+    };
+
+    namespace Detail
     {
-        struct State
+        /** Unbounded unless one of the coroutine's parameters is a GeneratorCapacity */
+        template <typename... Params>
+        size_t FindCapacity(Params &...params)
+        {
+            size_t capacity = SIZE_MAX;
+            ([&]()
+             {
+                if constexpr (std::is_same_v<std::remove_cv_t<Params>, GeneratorCapacity>)
+                {
+                    capacity = params.value;
+                } }(),
+             ...);
+            return capacity;
+        }
+
+        template <typename T, size_t InlineCapacity = 0>
+        struct GeneratorState;
+
+        template <typename T, typename R, size_t InlineCapacity, typename Stage>
+        struct Pipeline;
+
+        /**
+         * What NextAsync returns. Awaiting it takes a buffered value without suspending. Otherwise the
+         * awaiter queues itself on the generator and the value is delivered straight into it,
+         * so nothing is allocated either way. Nothing is taken until it is awaited.
+         */
+        template <typename T, size_t InlineCapacity = 0>
+        struct NextAwaiter
         {
-            std::queue<T> values{};
+            GeneratorState<T, InlineCapacity> *state;
+            std::coroutine_handle<> handle{};
+            std::optional<T> value{};
             std::exception_ptr exception{nullptr};
-            std::optional<Promise<std::optional<T>>> nextPromise{std::nullopt};
-            std::optional<R> returnValue{std::nullopt};
+            /** The next waiter in line */
+            NextAwaiter *next{nullptr};
+
+            bool await_ready()
+            {
+                return state->TryTake(*this);
+            }
+
+            void await_suspend(std::coroutine_handle<> awaiting)
+            {
+                handle = awaiting;
+                state->Wait(this);
+            }
+
+            std::optional<T> await_resume()
+            {
+                if (exception)
+                {
+                    std::rethrow_exception(exception);
+                }
+                return std::move(value);
+            }
+
+            /**
+             * @brief The next value as a Promise, e.g. to pass to the combinators.
+             * This allocates a coroutine that awaits a copy of this awaiter. It shares ownership of
+             * the generator's state, so the generator may be dropped while the read is pending.
+             */
+            Promise<std::optional<T>> AsPromise() const
+            {
+                return AwaitAsync(state->shared_from_this(), *this);
+            }
+
+        private:
+            static Promise<std::optional<T>> AwaitAsync(std::shared_ptr<GeneratorState<T, InlineCapacity>> keepAlive, NextAwaiter awaiter)
+            {
+                (void)keepAlive;
+                co_return co_await awaiter;
+            }
+        };
+
+        /**
+         * What NextBatchAsync returns. Takes what is buffered, up to the room in the output, and
+         * only suspends when nothing is. Resumes with how many values it wrote, 0 once the generator finished.
+         */
+        template <typename T, size_t InlineCapacity = 0>
+        struct NextBatchAwaiter
+        {
+            /** Waits for the first value when nothing is buffered */
+            NextAwaiter<T, InlineCapacity> one;
+            /** Output, either appended to or written over */
+            std::vector<T> *vector;
+            std::span<T> span;
+            size_t maxCount;
+            size_t count{0};
+
+            bool await_ready()
+            {
+                if (vector)
+                {
+                    vector->clear();
+                }
+                return one.state->TakeInto(*this) || one.await_ready();
+            }
+
+            void await_suspend(std::coroutine_handle<> awaiting)
+            {
+                one.await_suspend(awaiting);
+            }
+
+            size_t await_resume()
+            {
+                if (count != 0)
+                {
+                    return count;
+                }
+                auto value = one.await_resume();
+                if (!value.has_value())
+                {
+                    return 0;
+                }
+                Put(std::move(*value));
+                /** Whatever else was fed meanwhile */
+                one.state->TakeInto(*this);
+                return count;
+            }
+
+            void Put(T &&value)
+            {
+                if (vector)
+                {
+                    vector->push_back(std::move(value));
+                }
+                else
+                {
+                    span[count] = std::move(value);
+                }
+                count++;
+            }
+        };
+
+        template <typename Range>
+        struct YieldBatch
+        {
+            Range &&values;
+        };
+
+        /** Everything but the return value, shared by both AsyncGenerator specializations */
+        template <typename T, size_t InlineCapacity>
+        struct GeneratorState : std::enable_shared_from_this<GeneratorState<T, InlineCapacity>>
+        {
+            Detail::RingBuffer<T, InlineCapacity> values{};
+            /** Bounds values for generator coroutines, see GeneratorCapacity. An inline buffer bounds it too. */
+            size_t capacity{InlineCapacity ? InlineCapacity : SIZE_MAX};
+            /** The generator coroutine, while suspended on a full buffer */
+            std::coroutine_handle<> producer{};
+            std::exception_ptr exception{nullptr};
+            /** Consumers waiting for a value, served in the order they started waiting */
+            NextAwaiter<T, InlineCapacity> *head{nullptr};
+            NextAwaiter<T, InlineCapacity> *tail{nullptr};
             bool finished{false};
 
-            Promise<std::optional<T>> NextAsync()
+            /**
+             * @brief Settle next right away if possible.
+             * @return bool false if it has to wait.
+             */
+            bool TryTake(NextAwaiter<T, InlineCapacity> &next)
             {
-                Promise<std::optional<T>> promise{};
-                if (!values.empty())
+                if (!values.Empty())
                 {
-                    auto v = std::move(values.front());
-                    values.pop();
-                    promise.Resolve(std::make_optional<T>(std::move(v)));
+                    next.value.emplace(std::move(values.Front()));
+                    values.Pop();
+                    if (producer)
+                    {
+                        /** There is room again */
+                        Detail::Resume(std::exchange(producer, nullptr));
+                    }
                 }
                 else if (exception)
                 {
-                    promise.Reject(exception);
-                    exception = nullptr;
+                    next.exception = std::exchange(exception, nullptr);
                 }
-                else if (finished)
+                else if (!finished)
                 {
-                    promise.Resolve(std::optional<T>());
+                    return false;
                 }
-                else if (nextPromise.has_value())
+                return true;
+            }
+
+            /** @return bool false if nothing was buffered */
+            bool TakeInto(NextBatchAwaiter<T, InlineCapacity> &batch)
+            {
+                if (values.Empty())
                 {
-                    promise.Reject("Overlapping Next calls are not allowed");
+                    return false;
                 }
-                else
+                while (!values.Empty() && batch.count < batch.maxCount)
+                {
+                    batch.Put(std::move(values.Front()));
+                    values.Pop();
+                }
+                if (producer)
                 {
-                    nextPromise = promise;
+                    Detail::Resume(std::exchange(producer, nullptr));
                 }
-                return promise;
+                return true;
             }
 
-            void Feed(T&& v)
+            /** @param value From FindCapacity, SIZE_MAX if the coroutine has no GeneratorCapacity */
+            void SetCapacity(size_t value)
             {
-                if (nextPromise.has_value())
+                if (value == SIZE_MAX)
                 {
-                    auto promise = nextPromise.value();
-                    nextPromise.reset();
-                    promise.Resolve(std::make_optional<T>(std::move(v)));
+                    return;
                 }
-                else
+                if (InlineCapacity != 0 && value > InlineCapacity)
                 {
-                    values.push(std::move(v));
+                    throw std::invalid_argument("Generator capacity exceeds the inline buffer");
                 }
+                capacity = value;
             }
 
-            void Feed(const T &v)
+            void Wait(NextAwaiter<T, InlineCapacity> *next)
             {
-                if (nextPromise.has_value())
+                (tail ? tail->next : head) = next;
+                tail = next;
+            }
+
+            void Feed(T &&v)
+            {
+                if (head)
                 {
-                    auto promise = nextPromise.value();
-                    nextPromise.reset();
-                    promise.Resolve(std::make_optional<T>(v));
+                    HandOver(std::make_optional<T>(std::move(v)));
                 }
                 else
                 {
-                    values.push(v);
+                    values.Push(std::move(v));
                 }
             }
 
-            void Finish(R&& v)
+            void Feed(const T &v)
             {
-                finished = true;
-                /** Store the return value first, in case the final promise triggers usage of it */
-                returnValue = std::make_optional<R>(std::move(v));
-                /** Finish the stream */
-                if (nextPromise.has_value())
+                if (head)
                 {
-                    auto promise = nextPromise.value();
-                    nextPromise.reset();
-                    promise.Resolve(std::optional<T>());
+                    HandOver(std::make_optional<T>(v));
+                }
+                else
+                {
+                    values.Push(v);
                 }
             }
 
-            void Finish(const R &v)
+            template <typename Range>
+            void FeedBatch(Range &&batch)
             {
-                finished = true;
-                /** Store the return value first, in case the final promise triggers usage of it */
-                returnValue = std::make_optional<R>(v);
-                /** Finish the stream */
-                if (nextPromise.has_value())
+                /** A view or a borrowed range, like std::span, refers to elements someone else owns, even as an rvalue */
+                constexpr bool owned = !std::ranges::borrowed_range<Range> && !std::ranges::view<std::remove_cvref_t<Range>>;
+                for (auto &&v : batch)
+                {
+                    if constexpr (owned)
+                    {
+                        values.Emplace(std::move(v));
+                    }
+                    else
+                    {
+                        values.Emplace(v);
+                    }
+                }
+                /** Woken once all of it is buffered, so a batch reader takes the rest when it resumes */
+                while (head && !values.Empty())
                 {
-                    auto promise = nextPromise.value();
-                    nextPromise.reset();
-                    promise.Resolve(std::optional<T>());
+                    auto v = std::make_optional<T>(std::move(values.Front()));
+                    values.Pop();
+                    HandOver(std::move(v));
                 }
             }
 
+            /** The first waiter gets the exception, like the first read after it otherwise would */
             void Reject(const std::exception_ptr &e)
             {
                 finished = true;
-                if (nextPromise.has_value())
+                if (head)
                 {
-                    auto promise = nextPromise.value();
-                    nextPromise.reset();
-                    promise.Reject(e);
+                    HandOver(e);
                 }
                 else
                 {
                     exception = e;
                 }
+                End();
             }
 
             void Reject(const std::string &reason)
@@ -121,9 +343,99 @@ namespace JS
                 Reject(std::make_exception_ptr(std::runtime_error(reason)));
             }
 
+        protected:
+            /** Finish the stream, for everyone still waiting */
+            void End()
+            {
+                finished = true;
+                while (head)
+                {
+                    HandOver(std::optional<T>());
+                }
+            }
+
+        private:
+            /** Unlinked before resuming, the resumed consumer may wait again */
+            NextAwaiter<T, InlineCapacity> *PopWaiter()
+            {
+                auto next = head;
+                head = next->next;
+                tail = head ? tail : nullptr;
+                return next;
+            }
+
+            void HandOver(std::optional<T> &&value)
+            {
+                auto next = PopWaiter();
+                next->value = std::move(value);
+                Detail::Resume(next->handle);
+            }
+
+            void HandOver(const std::exception_ptr &e)
+            {
+                auto next = PopWaiter();
+                next->exception = e;
+                Detail::Resume(next->handle);
+            }
+        };
+
+        /** What co_yield awaits: nothing, unless the value filled the buffer */
+        template <typename State>
+        struct YieldAwaiter
+        {
+            State &state;
+
+            bool await_ready() const noexcept
+            {
+                return state.values.Size() < state.capacity;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) const noexcept
+            {
+                state.producer = handle;
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+        };
+    } // namespace Detail
+
+    /**
+     * @brief co_yield JS::Batch(values) in a generator coroutine to feed all of them at once.
+     * Elements of an rvalue range that owns them, like a std::vector, are moved. Those of views
+     * and borrowed ranges, like std::span, are copied. Waiting consumers are woken once the whole batch is
+     * buffered, and the producer then waits if the buffer went over capacity.
+     */
+    template <typename Range>
+    Detail::YieldBatch<Range> Batch(Range &&values)
+    {
+        return Detail::YieldBatch<Range>{std::forward<Range>(values)};
+    }
+
+    template <typename T, typename R = void, size_t InlineCapacity = 0>
+    struct AsyncGenerator
+    {
+        struct State : Detail::GeneratorState<T, InlineCapacity>
+        {
+            std::optional<R> returnValue{std::nullopt};
+
+            void Finish(R &&v)
+            {
+                /** Store the return value first, in case ending the stream triggers usage of it */
+                returnValue = std::make_optional<R>(std::move(v));
+                this->End();
+            }
+
+            void Finish(const R &v)
+            {
+                returnValue = std::make_optional<R>(v);
+                this->End();
+            }
+
             R GetReturnValue()
             {
-                if (!finished || !returnValue.has_value())
+                if (!this->finished || !returnValue.has_value())
                 {
                     throw std::runtime_error("Generator has not finished or return value is not set");
                 }
@@ -131,23 +443,37 @@ namespace JS
             }
         };
 
-        struct promise_type
+        /** Params is only used by coroutines taking an explicit frame allocator. See FrameAllocator.h */
+        template <typename... Params>
+        struct BasicPromiseType : Detail::FrameAllocated<Params...>
         {
             std::shared_ptr<State> state = std::make_shared<State>();
-            AsyncGenerator<T, R> get_return_object()
+            AsyncGenerator<T, R, InlineCapacity> get_return_object()
             {
-                return AsyncGenerator<T, R>{state};
+                return AsyncGenerator<T, R, InlineCapacity>{state};
             }
             std::suspend_never initial_suspend() { return {}; }
-            std::suspend_never yield_value(T &&v)
+            BasicPromiseType() = default;
+            template <typename... Args>
+            BasicPromiseType(Args &...args)
+            {
+                state->SetCapacity(Detail::FindCapacity(args...));
+            }
+            Detail::YieldAwaiter<State> yield_value(T &&v)
             {
                 state->Feed(std::move(v));
-                return {};
+                return {*state};
             }
-            std::suspend_never yield_value(const T &v)
+            Detail::YieldAwaiter<State> yield_value(const T &v)
             {
                 state->Feed(v);
-                return {};
+                return {*state};
+            }
+            template <typename Range>
+            Detail::YieldAwaiter<State> yield_value(Detail::YieldBatch<Range> batch)
+            {
+                state->FeedBatch(std::forward<Range>(batch.values));
+                return {*state};
             }
             void return_value(R &&v)
             {
@@ -166,6 +492,7 @@ namespace JS
                 state->Reject(std::current_exception());
             }
         };
+        using promise_type = BasicPromiseType<>;
 
         AsyncGenerator(std::shared_ptr<State> state)
             : _state(std::move(state))
@@ -177,9 +504,39 @@ namespace JS
         {
         }
 
-        Promise<std::optional<T>> NextAsync() const
+        /**
+         * @brief co_await for the next value, or std::nullopt once the generator finished.
+         * Several reads may be outstanding at once, they get values in the order they were awaited.
+         * Use AsPromise() on the result to get a Promise.
+         */
+        Detail::NextAwaiter<T, InlineCapacity> NextAsync() const
+        {
+            return Detail::NextAwaiter<T, InlineCapacity>{_state.get()};
+        }
+
+        /**
+         * @brief co_await to move up to maxCount buffered values into batch, replacing its contents.
+         * Suspends only while nothing is buffered. Resumes with how many, 0 once the generator finished.
+         */
+        Detail::NextBatchAwaiter<T, InlineCapacity> NextBatchAsync(std::vector<T> &batch, size_t maxCount) const
         {
-            return _state->NextAsync();
+            if (maxCount == 0)
+            {
+                throw std::invalid_argument("Batch size must be at least 1");
+            }
+            return Detail::NextBatchAwaiter<T, InlineCapacity>{{_state.get()}, &batch, {}, maxCount};
+        }
+
+        /**
+         * @brief Like the vector overload, writing over the front of batch.
+         */
+        Detail::NextBatchAwaiter<T, InlineCapacity> NextBatchAsync(std::span<T> batch) const
+        {
+            if (batch.empty())
+            {
+                throw std::invalid_argument("Batch size must be at least 1");
+            }
+            return Detail::NextBatchAwaiter<T, InlineCapacity>{{_state.get()}, nullptr, batch, batch.size()};
         }
 
         void Feed(T &&value) const
@@ -218,125 +575,53 @@ namespace JS
         }
 
     private:
+        template <typename, typename, size_t, typename>
+        friend struct Detail::Pipeline;
+
         std::shared_ptr<State> _state;
     };
 
-    template <typename T>
-    struct AsyncGenerator<T, void>
+    template <typename T, size_t InlineCapacity>
+    struct AsyncGenerator<T, void, InlineCapacity>
     {
-        struct State
+        struct State : Detail::GeneratorState<T, InlineCapacity>
         {
-            std::queue<T> values{};
-            std::exception_ptr exception{nullptr};
-            std::optional<Promise<std::optional<T>>> nextPromise{std::nullopt};
-            bool finished{false};
-
-            Promise<std::optional<T>> NextAsync()
-            {
-                Promise<std::optional<T>> promise{};
-                if (!values.empty())
-                {
-                    auto v = std::move(values.front());
-                    values.pop();
-                    promise.Resolve(std::make_optional<T>(std::move(v)));
-                }
-                else if (exception)
-                {
-                    promise.Reject(exception);
-                    exception = nullptr;
-                }
-                else if (finished)
-                {
-                    promise.Resolve(std::optional<T>());
-                }
-                else if (nextPromise.has_value())
-                {
-                    promise.Reject("Overlapping Next calls are not allowed");
-                }
-                else
-                {
-                    nextPromise = promise;
-                }
-                return promise;
-            }
-
-            void Feed(T&& v)
-            {
-                if (nextPromise.has_value())
-                {
-                    auto promise = nextPromise.value();
-                    nextPromise.reset();
-                    promise.Resolve(std::make_optional<T>(std::move(v)));
-                }
-                else
-                {
-                    values.push(std::move(v));
-                }
-            }
-
-            void Feed(const T &v)
-            {
-                if (nextPromise.has_value())
-                {
-                    auto promise = nextPromise.value();
-                    nextPromise.reset();
-                    promise.Resolve(std::make_optional<T>(v));
-                }
-                else
-                {
-                    values.push(v);
-                }
-            }
-
             void Finish()
             {
-                finished = true;
-                if (nextPromise.has_value())
-                {
-                    auto promise = nextPromise.value();
-                    nextPromise.reset();
-                    promise.Resolve(std::optional<T>());
-                }
-            }
-
-            void Reject(const std::exception_ptr &e)
-            {
-                finished = true;
-                if (nextPromise.has_value())
-                {
-                    auto promise = nextPromise.value();
-                    nextPromise.reset();
-                    promise.Reject(e);
-                }
-                else
-                {
-                    exception = e;
-                }
-            }
-
-            void Reject(const std::string &reason)
-            {
-                Reject(std::make_exception_ptr(std::runtime_error(reason)));
+                this->End();
             }
         };
 
-        struct promise_type
+        template <typename... Params>
+        struct BasicPromiseType : Detail::FrameAllocated<Params...>
         {
             std::shared_ptr<State> state = std::make_shared<State>();
-            AsyncGenerator<T> get_return_object()
+            AsyncGenerator<T, void, InlineCapacity> get_return_object()
             {
-                return AsyncGenerator<T>{state};
+                return AsyncGenerator<T, void, InlineCapacity>{state};
             }
             std::suspend_never initial_suspend() { return {}; }
-            std::suspend_never yield_value(T &&v)
+            BasicPromiseType() = default;
+            template <typename... Args>
+            BasicPromiseType(Args &...args)
+            {
+                state->SetCapacity(Detail::FindCapacity(args...));
+            }
+            Detail::YieldAwaiter<State> yield_value(T &&v)
             {
                 state->Feed(std::move(v));
-                return {};
+                return {*state};
             }
-            std::suspend_never yield_value(const T &v)
+            Detail::YieldAwaiter<State> yield_value(const T &v)
             {
                 state->Feed(v);
-                return {};
+                return {*state};
+            }
+            template <typename Range>
+            Detail::YieldAwaiter<State> yield_value(Detail::YieldBatch<Range> batch)
+            {
+                state->FeedBatch(std::forward<Range>(batch.values));
+                return {*state};
             }
             void return_void() {}
             std::suspend_never final_suspend() noexcept
@@ -349,6 +634,7 @@ namespace JS
                 state->Reject(std::current_exception());
             }
         };
+        using promise_type = BasicPromiseType<>;
 
         AsyncGenerator(std::shared_ptr<State> state)
             : _state(std::move(state))
@@ -360,9 +646,39 @@ namespace JS
         {
         }
 
-        Promise<std::optional<T>> NextAsync() const
+        /**
+         * @brief co_await for the next value, or std::nullopt once the generator finished.
+         * Several reads may be outstanding at once, they get values in the order they were awaited.
+         * Use AsPromise() on the result to get a Promise.
+         */
+        Detail::NextAwaiter<T, InlineCapacity> NextAsync() const
         {
-            return _state->NextAsync();
+            return Detail::NextAwaiter<T, InlineCapacity>{_state.get()};
+        }
+
+        /**
+         * @brief co_await to move up to maxCount buffered values into batch, replacing its contents.
+         * Suspends only while nothing is buffered. Resumes with how many, 0 once the generator finished.
+         */
+        Detail::NextBatchAwaiter<T, InlineCapacity> NextBatchAsync(std::vector<T> &batch, size_t maxCount) const
+        {
+            if (maxCount == 0)
+            {
+                throw std::invalid_argument("Batch size must be at least 1");
+            }
+            return Detail::NextBatchAwaiter<T, InlineCapacity>{{_state.get()}, &batch, {}, maxCount};
+        }
+
+        /**
+         * @brief Like the vector overload, writing over the front of batch.
+         */
+        Detail::NextBatchAwaiter<T, InlineCapacity> NextBatchAsync(std::span<T> batch) const
+        {
+            if (batch.empty())
+            {
+                throw std::invalid_argument("Batch size must be at least 1");
+            }
+            return Detail::NextBatchAwaiter<T, InlineCapacity>{{_state.get()}, nullptr, batch, batch.size()};
         }
 
         void Feed(T &&value) const
@@ -391,9 +707,25 @@ namespace JS
         }
 
     private:
+        template <typename, typename, size_t, typename>
+        friend struct Detail::Pipeline;
+
         std::shared_ptr<State> _state;
     };
 
     // No specialization for void, as it does not make sense to yield void values.
 
 } // namespace JS
+
+/** Coroutines taking an explicit frame allocator. See FrameAllocator.h */
+template <typename T, typename R, size_t InlineCapacity, typename... Args>
+struct std::coroutine_traits<JS::AsyncGenerator<T, R, InlineCapacity>, std::allocator_arg_t, JS::FrameAllocator &, Args...>
+{
+    using promise_type = typename JS::AsyncGenerator<T, R, InlineCapacity>::template BasicPromiseType<std::allocator_arg_t, JS::FrameAllocator &, Args...>;
+};
+
+template <typename T, typename R, size_t InlineCapacity, typename Self, typename... Args>
+struct std::coroutine_traits<JS::AsyncGenerator<T, R, InlineCapacity>, Self, std::allocator_arg_t, JS::FrameAllocator &, Args...>
+{
+    using promise_type = typename JS::AsyncGenerator<T, R, InlineCapacity>::template BasicPromiseType<Self, std::allocator_arg_t, JS::FrameAllocator &, Args...>;
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace JS
+{
+    template <typename Signature, size_t Capacity = 6 * sizeof(void *)>
+    class Callback;
+
+    /**
+     * @brief A move only replacement for std::function.
+     * Callables up to Capacity bytes are stored inline, larger ones go to the heap.
+     * The default capacity fits the captures of the Promise combinators.
+     */
+    template <typename R, typename... Args, size_t Capacity>
+    class Callback<R(Args...), Capacity>
+    {
+        static_assert(Capacity >= sizeof(void *));
+
+    public:
+        Callback() = default;
+
+        Callback(std::nullptr_t)
+        {
+        }
+
+        template <typename F>
+            requires(!std::is_same_v<std::remove_cvref_t<F>, Callback> &&
+                     std::is_invocable_r_v<R, std::decay_t<F> &, Args...>)
+        Callback(F &&f)
+        {
+            using Fn = std::decay_t<F>;
+            if constexpr (IsInline<Fn>)
+            {
+                new (_storage) Fn(std::forward<F>(f));
+            }
+            else
+            {
+                *reinterpret_cast<Fn **>(_storage) = new Fn(std::forward<F>(f));
+            }
+            _vtable = &VTableFor<Fn>;
+        }
+
+        Callback(Callback &&other) noexcept
+        {
+            MoveFrom(other);
+        }
+
+        Callback &operator=(Callback &&other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                MoveFrom(other);
+            }
+            return *this;
+        }
+
+        Callback(const Callback &) = delete;
+        Callback &operator=(const Callback &) = delete;
+
+        ~Callback()
+        {
+            Reset();
+        }
+
+        explicit operator bool() const
+        {
+            return _vtable != nullptr;
+        }
+
+        R operator()(Args... args)
+        {
+            return _vtable->invoke(_storage, std::forward<Args>(args)...);
+        }
+
+    private:
+        struct VTable
+        {
+            R (*invoke)(void *, Args &&...);
+            /** Move construct into dst and destroy src */
+            void (*relocate)(void *dst, void *src) noexcept;
+            void (*destroy)(void *) noexcept;
+        };
+
+        template <typename Fn>
+        static constexpr bool IsInline = sizeof(Fn) <= Capacity &&
+                                         alignof(Fn) <= alignof(std::max_align_t) &&
+                                         std::is_nothrow_move_constructible_v<Fn>;
+
+        template <typename Fn>
+        static Fn &Get(void *storage)
+        {
+            if constexpr (IsInline<Fn>)
+            {
+                return *std::launder(reinterpret_cast<Fn *>(storage));
+            }
+            else
+            {
+                return **reinterpret_cast<Fn **>(storage);
+            }
+        }
+
+        template <typename Fn>
+        static constexpr VTable VTableFor{
+            [](void *storage, Args &&...args) -> R
+            { return std::invoke(Get<Fn>(storage), std::forward<Args>(args)...); },
+            [](void *dst, void *src) noexcept
+            {
+                if constexpr (IsInline<Fn>)
+                {
+                    new (dst) Fn(std::move(Get<Fn>(src)));
+                    Get<Fn>(src).~Fn();
+                }
+                else
+                {
+                    *reinterpret_cast<Fn **>(dst) = *reinterpret_cast<Fn **>(src);
+                }
+            },
+            [](void *storage) noexcept
+            {
+                if constexpr (IsInline<Fn>)
+                {
+                    Get<Fn>(storage).~Fn();
+                }
+                else
+                {
+                    delete *reinterpret_cast<Fn **>(storage);
+                }
+            }};
+
+        void MoveFrom(Callback &other) noexcept
+        {
+            if (other._vtable)
+            {
+                other._vtable->relocate(_storage, other._storage);
+                _vtable = std::exchange(other._vtable, nullptr);
+            }
+        }
+
+        void Reset()
+        {
+            if (_vtable)
+            {
+                std::exchange(_vtable, nullptr)->destroy(_storage);
+            }
+        }
+
+        alignas(std::max_align_t) std::byte _storage[Capacity];
+        const VTable *_vtable = nullptr;
+    };
+
+} // namespace JS
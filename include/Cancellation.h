@@ -0,0 +1,214 @@
+#pragma once
+
+#include <stdexcept>
+#include <utility>
+#include "Callback.h"
+#include "Ref.h"
+
+/**
+ * Cooperative cancellation.
+ *
+ * A CancellationSource signals its tokens once. Work that can stop early listens on a token with
+ * a CancellationRegistration. The registration is linked into the token's list in place, so
+ * registering never allocates. It unlinks itself when it goes out of scope, so embed it in
+ * whatever object owns the work.
+ *
+ * Every Promise can be cancelled too. See Promise::Cancel.
+ *
+ * Single threaded, like Promise.
+ */
+
+namespace JS
+{
+    /**
+     * @brief The rejection reason of a cancelled promise.
+     */
+    class CancelledError : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    class CancellationRegistration;
+
+    namespace Detail
+    {
+        struct CancellationState : RefCounted<CancellationState>
+        {
+            bool cancelled = false;
+            CancellationRegistration *head = nullptr;
+            CancellationRegistration *tail = nullptr;
+
+            void Cancel();
+            void Link(CancellationRegistration *registration);
+            void Unlink(CancellationRegistration *registration);
+        };
+    } // namespace Detail
+
+    class CancellationToken
+    {
+    public:
+        /** A token that is never cancelled */
+        CancellationToken() = default;
+
+        bool IsCancelled() const
+        {
+            return _state.Get() && _state->cancelled;
+        }
+
+        bool CanBeCancelled() const
+        {
+            return _state.Get() != nullptr;
+        }
+
+        /**
+         * @throws CancelledError
+         */
+        void ThrowIfCancelled() const
+        {
+            if (IsCancelled())
+            {
+                throw CancelledError("Cancelled");
+            }
+        }
+
+        explicit CancellationToken(Detail::Ref<Detail::CancellationState> state)
+            : _state(std::move(state))
+        {
+        }
+
+    private:
+        friend class CancellationRegistration;
+        Detail::Ref<Detail::CancellationState> _state{};
+    };
+
+    class CancellationSource
+    {
+    public:
+        CancellationSource()
+            : _state(new Detail::CancellationState())
+        {
+        }
+
+        CancellationToken Token() const
+        {
+            return CancellationToken{_state};
+        }
+
+        bool IsCancelled() const
+        {
+            return _state->cancelled;
+        }
+
+        /**
+         * @brief Run the registered callbacks, in registration order. Only the first call counts.
+         */
+        void Cancel() const
+        {
+            _state->Cancel();
+        }
+
+    private:
+        Detail::Ref<Detail::CancellationState> _state;
+    };
+
+    /**
+     * @brief Calls back once when a token is cancelled, unless it goes out of scope first.
+     * Registering on a token that is already cancelled calls back right away.
+     */
+    class CancellationRegistration
+    {
+    public:
+        CancellationRegistration() = default;
+
+        CancellationRegistration(const CancellationToken &token, Callback<void()> callback)
+        {
+            Register(token, std::move(callback));
+        }
+
+        /** Linked in place, so it cannot move */
+        CancellationRegistration(const CancellationRegistration &) = delete;
+        CancellationRegistration &operator=(const CancellationRegistration &) = delete;
+
+        ~CancellationRegistration()
+        {
+            Unregister();
+        }
+
+        /**
+         * @brief Listen on token, replacing any earlier registration.
+         */
+        void Register(const CancellationToken &token, Callback<void()> callback)
+        {
+            Unregister();
+            if (!token.CanBeCancelled())
+            {
+                return;
+            }
+            if (token.IsCancelled())
+            {
+                callback();
+                return;
+            }
+            _callback = std::move(callback);
+            _state = token._state;
+            _state->Link(this);
+        }
+
+        void Unregister()
+        {
+            if (_state.Get())
+            {
+                _state->Unlink(this);
+                _state = {};
+                _callback = nullptr;
+            }
+        }
+
+    private:
+        friend struct Detail::CancellationState;
+
+        Detail::Ref<Detail::CancellationState> _state{};
+        CancellationRegistration *_prev = nullptr;
+        CancellationRegistration *_next = nullptr;
+        Callback<void()> _callback{};
+    };
+
+    namespace Detail
+    {
+        inline void CancellationState::Link(CancellationRegistration *registration)
+        {
+            registration->_prev = tail;
+            registration->_next = nullptr;
+            (tail ? tail->_next : head) = registration;
+            tail = registration;
+        }
+
+        inline void CancellationState::Unlink(CancellationRegistration *registration)
+        {
+            (registration->_prev ? registration->_prev->_next : head) = registration->_next;
+            (registration->_next ? registration->_next->_prev : tail) = registration->_prev;
+        }
+
+        inline void CancellationState::Cancel()
+        {
+            if (cancelled)
+            {
+                return;
+            }
+            cancelled = true;
+            /** The registrations hold the state, and a callback may drop the last of them */
+            Ref<CancellationState> self{this};
+            while (head)
+            {
+                auto registration = head;
+                Unlink(registration);
+                /** Moved out first, the callback may destroy the registration */
+                auto callback = std::move(registration->_callback);
+                registration->_state = {};
+                callback();
+            }
+        }
+    } // namespace Detail
+
+} // namespace JS
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Callback.h"
+#include "Executor.h"
+#include "Promise.h"
+#include "TimerWheel.h"
+
+/**
+ * A single threaded run loop, so the library can drive coroutines without tev-cpp.
+ *
+ * Each iteration fires the expired timers, then resumes the coroutines that were ready at
+ * the start of the iteration. While the loop runs it is the thread's executor, so resolved
+ * promises queue their awaiters here instead of resuming them inline. See Executor.h.
+ * Its timers live on a TimerWheel, which is also installed, so JS::Delay and JS::WithTimeout work.
+ *
+ * Everything except Post must be called from the loop's thread.
+ */
+
+namespace JS
+{
+    class EventLoop : public Executor
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using TimeoutHandle = TimerWheel::TimeoutHandle;
+
+        EventLoop() = default;
+        EventLoop(const EventLoop &) = delete;
+        EventLoop &operator=(const EventLoop &) = delete;
+
+        /**
+         * @brief Call callback once, after ms milliseconds.
+         *
+         * @return TimeoutHandle For ClearTimeout.
+         */
+        TimeoutHandle SetTimeout(Callback<void()> callback, uint64_t ms)
+        {
+            return _timers.SetTimeout(std::move(callback), ms, Now());
+        }
+
+        /**
+         * @brief Cancel a timeout. Handles of fired or cleared timeouts are ignored.
+         */
+        void ClearTimeout(TimeoutHandle handle)
+        {
+            _timers.ClearTimeout(handle);
+        }
+
+        /**
+         * @brief A promise resolved after ms milliseconds. Cancelling the promise clears the timer.
+         */
+        Promise<void> Delay(uint64_t ms)
+        {
+            return Detail::DelayOn(_timers, ms, Now());
+        }
+
+        /**
+         * @brief The loop's timers. Install them with ScopedTimerWheel to use JS::Delay before the loop runs.
+         */
+        TimerWheel &Timers()
+        {
+            return _timers;
+        }
+
+        /**
+         * @brief Queue a coroutine to be resumed in the next iteration.
+         * This may be called from any thread, e.g. by ThreadSafePromise.
+         */
+        void Post(std::coroutine_handle<> handle) override
+        {
+            if (std::this_thread::get_id() == _owner.load(std::memory_order_relaxed))
+            {
+                _ready.push_back(handle);
+                return;
+            }
+            {
+                std::lock_guard lock{_remoteMutex};
+                _remote.push_back(handle);
+                _hasRemote.store(true, std::memory_order_release);
+            }
+            _remoteSignal.notify_one();
+        }
+
+        /**
+         * @brief Run until there are no timers and no ready coroutines left.
+         * Like a JS runtime, this does not wait for other threads.
+         */
+        void Run()
+        {
+            ScopedExecutor scope{*this};
+            ScopedTimerWheel timers{_timers};
+            OwnerScope owner{*this};
+            while (true)
+            {
+                RunOnce();
+                if (_ready.empty())
+                {
+                    if (_timers.Empty() && !_hasRemote.load(std::memory_order_acquire))
+                    {
+                        return;
+                    }
+                }
+                Idle();
+            }
+        }
+
+        /**
+         * @brief Run until the promise settles.
+         * When there is nothing left to do locally, this waits for posts from other threads,
+         * as only they can still settle the promise.
+         *
+         * @note If the coroutine awaits a ThreadSafePromise before the loop runs, install the loop
+         * with ScopedExecutor before calling the coroutine, so it is resumed here.
+         *
+         * @return T The promise's value. Its rejection is rethrown.
+         */
+        template <typename T>
+        T RunUntilComplete(Promise<T> promise)
+        {
+            std::optional<typename Detail::ResultOf<T>::Type> result{};
+            std::exception_ptr exception{nullptr};
+            if constexpr (std::is_void_v<T>)
+            {
+                promise.Then([&]()
+                             { result.emplace(); });
+            }
+            else
+            {
+                promise.Then([&](T value)
+                             { result.emplace(std::move(value)); });
+            }
+            promise.Catch([&](const std::exception_ptr &e)
+                          { exception = e; });
+            {
+                ScopedExecutor scope{*this};
+                ScopedTimerWheel timers{_timers};
+                OwnerScope owner{*this};
+                while (true)
+                {
+                    RunOnce();
+                    if (result || exception)
+                    {
+                        break;
+                    }
+                    Idle();
+                }
+            }
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+            if constexpr (!std::is_void_v<T>)
+            {
+                return std::move(result).value();
+            }
+        }
+
+    private:
+        /** Remembers the loop's thread while it runs, so Post can tell remote posts apart */
+        class OwnerScope
+        {
+        public:
+            explicit OwnerScope(EventLoop &loop)
+                : _loop(loop), _previous(loop._owner.exchange(std::this_thread::get_id(), std::memory_order_relaxed))
+            {
+            }
+
+            ~OwnerScope()
+            {
+                _loop._owner.store(_previous, std::memory_order_relaxed);
+            }
+
+        private:
+            EventLoop &_loop;
+            std::thread::id _previous;
+        };
+
+        Clock::time_point Now() const
+        {
+            /** Cached during an iteration, so setting and firing timers does not read the clock each time */
+            return _now ? *_now : Clock::now();
+        }
+
+        void RunOnce()
+        {
+            _now = Clock::now();
+            TakeRemote();
+            _timers.Advance(*_now);
+            /** Only what is ready now. Coroutines posted meanwhile wait for the next iteration. */
+            std::swap(_ready, _running);
+            for (auto handle : _running)
+            {
+                handle.resume();
+            }
+            _running.clear();
+            _now.reset();
+        }
+
+        /** Unless something is ready, sleep until the next timer or a post from another thread */
+        void Idle()
+        {
+            if (!_ready.empty())
+            {
+                return;
+            }
+            auto deadline = _timers.NextDeadline();
+            /** A wait that has already timed out still costs a syscall and the kernel's timer slack */
+            if (deadline && *deadline <= Clock::now())
+            {
+                return;
+            }
+            std::unique_lock lock{_remoteMutex};
+            auto hasRemote = [this]()
+            { return _hasRemote.load(std::memory_order_relaxed); };
+            if (!deadline)
+            {
+                _remoteSignal.wait(lock, hasRemote);
+            }
+            else
+            {
+                _remoteSignal.wait_until(lock, *deadline, hasRemote);
+            }
+        }
+
+        void TakeRemote()
+        {
+            if (!_hasRemote.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            std::lock_guard lock{_remoteMutex};
+            _ready.insert(_ready.end(), _remote.begin(), _remote.end());
+            _remote.clear();
+            _hasRemote.store(false, std::memory_order_relaxed);
+        }
+
+        std::vector<std::coroutine_handle<>> _ready{};
+        std::vector<std::coroutine_handle<>> _running{};
+        TimerWheel _timers{};
+        std::optional<Clock::time_point> _now{};
+        /** Read by Post on other threads */
+        std::atomic<std::thread::id> _owner{};
+
+        std::mutex _remoteMutex{};
+        std::condition_variable _remoteSignal{};
+        std::vector<std::coroutine_handle<>> _remote{};
+        std::atomic<bool> _hasRemote{false};
+    };
+
+} // namespace JS
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * Where suspended coroutines are resumed.
+ *
+ * An executor is installed per thread with ScopedExecutor. When a Promise is resolved,
+ * the coroutine awaiting it is posted to the current executor instead of being resumed on
+ * the resolving call stack. AsyncGenerator consumers go through Promise, so the same applies.
+ * Without an installed executor, coroutines are resumed inline, as before.
+ *
+ * A coroutine returning into an awaiting coroutine is posted too, so co_return keeps the
+ * executor's ordering. Only without an executor is it a direct symmetric transfer.
+ *
+ * Awaitables that resume from another thread, like ThreadSafePromise, remember the awaiter's
+ * executor and post the resumption to it.
+ *
+ * The executor must outlive everything posted to it. C++ is not safe.
+ */
+
+namespace JS
+{
+    struct Executor
+    {
+        virtual ~Executor() = default;
+
+        /**
+         * @brief Schedule a suspended coroutine to be resumed.
+         * This may be called from any thread.
+         */
+        virtual void Post(std::coroutine_handle<> handle) = 0;
+
+        /**
+         * @brief The executor installed on this thread.
+         *
+         * @return Executor* nullptr if none.
+         */
+        static Executor *Current()
+        {
+            return CurrentSlot();
+        }
+
+    private:
+        friend class ScopedExecutor;
+        static Executor *&CurrentSlot()
+        {
+            static thread_local Executor *current = nullptr;
+            return current;
+        }
+    };
+
+    /**
+     * @brief Install an executor as this thread's executor for the lifetime of this object.
+     */
+    class ScopedExecutor
+    {
+    public:
+        explicit ScopedExecutor(Executor &executor)
+            : _previous(std::exchange(Executor::CurrentSlot(), &executor))
+        {
+        }
+
+        ~ScopedExecutor()
+        {
+            Executor::CurrentSlot() = _previous;
+        }
+
+        ScopedExecutor(const ScopedExecutor &) = delete;
+        ScopedExecutor &operator=(const ScopedExecutor &) = delete;
+
+    private:
+        Executor *_previous;
+    };
+
+    /**
+     * @brief Resumes right away on the posting thread. Same as having no executor.
+     * Useful to switch inline resumption back on inside a scope.
+     */
+    class InlineExecutor : public Executor
+    {
+    public:
+        void Post(std::coroutine_handle<> handle) override
+        {
+            handle.resume();
+        }
+    };
+
+    /**
+     * @brief Queues resumptions until Drain is called, e.g. once per event loop iteration.
+     * Coroutines posted while draining wait for the next Drain, so one Drain runs a bounded
+     * amount of user code and nothing is resumed re-entrantly from Resolve.
+     * Post is thread safe. Drain must only be called from one thread at a time.
+     */
+    class QueueExecutor : public Executor
+    {
+    public:
+        void Post(std::coroutine_handle<> handle) override
+        {
+            std::lock_guard lock{_mutex};
+            _queue.push_back(handle);
+        }
+
+        /**
+         * @brief Resume queued coroutines in FIFO order.
+         *
+         * @param max The most to resume in this call.
+         * @return size_t How many were resumed.
+         */
+        size_t Drain(size_t max = SIZE_MAX)
+        {
+            /** Taken out of the member, in case a resumed coroutine drains too */
+            auto batch = std::move(_draining);
+            {
+                std::lock_guard lock{_mutex};
+                size_t count = std::min(max, _queue.size());
+                batch.assign(_queue.begin(), _queue.begin() + count);
+                _queue.erase(_queue.begin(), _queue.begin() + count);
+            }
+            for (auto handle : batch)
+            {
+                handle.resume();
+            }
+            size_t count = batch.size();
+            _draining = std::move(batch);
+            return count;
+        }
+
+        bool Empty() const
+        {
+            std::lock_guard lock{_mutex};
+            return _queue.empty();
+        }
+
+    private:
+        mutable std::mutex _mutex{};
+        std::deque<std::coroutine_handle<>> _queue{};
+        /** Reused between drains to avoid allocating */
+        std::vector<std::coroutine_handle<>> _draining{};
+    };
+
+    namespace Detail
+    {
+        /** Resume through this thread's executor, or inline if there is none */
+        inline void Resume(std::coroutine_handle<> handle)
+        {
+            if (auto executor = Executor::Current())
+            {
+                executor->Post(handle);
+            }
+            else
+            {
+                handle.resume();
+            }
+        }
+    } // namespace Detail
+
+} // namespace JS
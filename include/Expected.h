@@ -0,0 +1,399 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "Promise.h"
+
+/**
+ * An error channel that does not throw.
+ *
+ * A Promise<Expected<T, E>> carries failures as values. Awaiting it yields the Expected,
+ * and AllExpected/AnyExpected short circuit on it. No exception is created, thrown or caught,
+ * so a burst of failures costs about as much as a burst of successes.
+ *
+ * Exceptions thrown inside such a coroutine still reject the promise as usual.
+ */
+
+namespace JS
+{
+    /**
+     * @brief Wraps an error to construct a failed Expected.
+     */
+    template <typename E>
+    class Unexpected
+    {
+    public:
+        explicit Unexpected(E error)
+            : _error(std::move(error))
+        {
+        }
+
+        E &Error() &
+        {
+            return _error;
+        }
+
+        const E &Error() const &
+        {
+            return _error;
+        }
+
+        E &&Error() &&
+        {
+            return std::move(_error);
+        }
+
+    private:
+        E _error;
+    };
+
+    /**
+     * @brief Either a value or an error. A small stand in for C++23 std::expected.
+     * Value() and Error() do not check, call HasValue() first.
+     */
+    template <typename T, typename E>
+    class Expected
+    {
+    public:
+        Expected(T value)
+            : _storage(std::in_place_index<0>, std::move(value))
+        {
+        }
+
+        template <typename G>
+            requires std::is_constructible_v<E, G>
+        Expected(Unexpected<G> error)
+            : _storage(std::in_place_index<1>, std::move(error).Error())
+        {
+        }
+
+        bool HasValue() const
+        {
+            return _storage.index() == 0;
+        }
+
+        explicit operator bool() const
+        {
+            return HasValue();
+        }
+
+        T &Value() &
+        {
+            return *std::get_if<0>(&_storage);
+        }
+
+        const T &Value() const &
+        {
+            return *std::get_if<0>(&_storage);
+        }
+
+        T &&Value() &&
+        {
+            return std::move(*std::get_if<0>(&_storage));
+        }
+
+        E &Error() &
+        {
+            return *std::get_if<1>(&_storage);
+        }
+
+        const E &Error() const &
+        {
+            return *std::get_if<1>(&_storage);
+        }
+
+        E &&Error() &&
+        {
+            return std::move(*std::get_if<1>(&_storage));
+        }
+
+    private:
+        std::variant<T, E> _storage;
+    };
+
+    template <typename E>
+    class Expected<void, E>
+    {
+    public:
+        Expected() = default;
+
+        template <typename G>
+            requires std::is_constructible_v<E, G>
+        Expected(Unexpected<G> error)
+            : _error(std::in_place, std::move(error).Error())
+        {
+        }
+
+        bool HasValue() const
+        {
+            return !_error.has_value();
+        }
+
+        explicit operator bool() const
+        {
+            return HasValue();
+        }
+
+        E &Error() &
+        {
+            return *_error;
+        }
+
+        const E &Error() const &
+        {
+            return *_error;
+        }
+
+        E &&Error() &&
+        {
+            return std::move(*_error);
+        }
+
+    private:
+        std::optional<E> _error{};
+    };
+
+    namespace Detail
+    {
+        template <typename P>
+        struct PromisedExpected
+        {
+        };
+
+        template <typename T, typename E>
+        struct PromisedExpected<Promise<Expected<T, E>>>
+        {
+            using Value = T;
+            using Error = E;
+        };
+
+        template <typename Range>
+        using ExpectedValueOf = typename PromisedExpected<std::remove_cvref_t<std::ranges::range_value_t<Range>>>::Value;
+
+        template <typename Range>
+        using ExpectedErrorOf = typename PromisedExpected<std::remove_cvref_t<std::ranges::range_value_t<Range>>>::Error;
+
+        template <typename T>
+        struct ExpectedAllResult
+        {
+            using Type = std::vector<T>;
+        };
+
+        template <>
+        struct ExpectedAllResult<void>
+        {
+            using Type = void;
+        };
+    } // namespace Detail
+
+    /**
+     * @brief Wait for all promises to succeed, or the first one to fail. The others are cancelled then.
+     * Errors short circuit as values, exceptions are forwarded as rejections.
+     *
+     * @param promises Any input range of Promise<Expected<T, E>>.
+     * @return Promise<Expected<std::vector<T>, E>> Or Promise<Expected<void, E>> for T = void.
+     */
+    template <std::ranges::input_range Range,
+              typename T = Detail::ExpectedValueOf<Range>,
+              typename E = Detail::ExpectedErrorOf<Range>>
+    Promise<Expected<typename Detail::ExpectedAllResult<T>::Type, E>> AllExpected(Range &&promises)
+    {
+        using Output = Expected<typename Detail::ExpectedAllResult<T>::Type, E>;
+        struct NoValues
+        {
+        };
+        struct Values
+        {
+            std::vector<std::optional<T>> values{};
+        };
+        struct Result : std::conditional_t<std::is_void_v<T>, NoValues, Values>, Detail::Contenders<Promise<Expected<T, E>>>
+        {
+            Promise<Output> promise{};
+            /** One extra for the registration itself, so early settles cannot finish it */
+            size_t pending{1};
+
+            void Complete()
+            {
+                if (--pending != 0 || this->finished)
+                {
+                    return;
+                }
+                this->finished = true;
+                this->inputs.clear();
+                if constexpr (std::is_void_v<T>)
+                {
+                    promise.Resolve(Output{});
+                }
+                else
+                {
+                    std::vector<T> results{};
+                    results.reserve(this->values.size());
+                    for (auto &slot : this->values)
+                    {
+                        results.push_back(std::move(slot).value());
+                    }
+                    promise.Resolve(Output{std::move(results)});
+                }
+            }
+        };
+        auto result = std::make_shared<Result>();
+        result->Follow(result->promise);
+        if constexpr (std::ranges::sized_range<Range>)
+        {
+            result->inputs.reserve(std::ranges::size(promises));
+            if constexpr (!std::is_void_v<T>)
+            {
+                result->values.reserve(std::ranges::size(promises));
+            }
+        }
+        size_t count = 0;
+        for (const Promise<Expected<T, E>> &promise : promises)
+        {
+            count++;
+            if (result->finished)
+            {
+                /** Short circuited by an earlier promise that had already failed */
+                promise.Cancel();
+                continue;
+            }
+            size_t i = result->inputs.size();
+            result->inputs.push_back(promise);
+            if constexpr (!std::is_void_v<T>)
+            {
+                result->values.emplace_back();
+            }
+            result->pending++;
+            promise.Then([=](Expected<T, E> outcome)
+                         {
+                if (result->finished)
+                {
+                    return;
+                }
+                if (!outcome)
+                {
+                    /** The first to fail decides, the rest are cancelled */
+                    result->Decide(i);
+                    result->promise.Resolve(Output{Unexpected<E>{std::move(outcome).Error()}});
+                    return;
+                }
+                if constexpr (!std::is_void_v<T>)
+                {
+                    result->values[i].emplace(std::move(outcome).Value());
+                }
+                result->Complete(); });
+            promise.Catch([=](const std::exception_ptr &e)
+                          {
+                if (result->Decide(i))
+                {
+                    result->promise.Reject(e);
+                } });
+        }
+        if (count == 0)
+        {
+            throw std::invalid_argument("Empty promises");
+        }
+        result->Complete();
+        return result->promise;
+    }
+
+    /**
+     * @brief Wait for the first promise to succeed, or all of them to fail. The others are cancelled then.
+     * A rejection counts as one more failure. If all fail, the result carries the error of the
+     * last one to fail, or rejects with its exception.
+     *
+     * @param promises Any input range of Promise<Expected<T, E>>.
+     * @return Promise<Expected<T, E>>
+     */
+    template <std::ranges::input_range Range,
+              typename T = Detail::ExpectedValueOf<Range>,
+              typename E = Detail::ExpectedErrorOf<Range>>
+    Promise<Expected<T, E>> AnyExpected(Range &&promises)
+    {
+        struct Result : Detail::Contenders<Promise<Expected<T, E>>>
+        {
+            Promise<Expected<T, E>> promise{};
+            /** The last failure, one or the other */
+            std::optional<E> lastError{};
+            std::exception_ptr lastException{nullptr};
+            /** One extra for the registration itself, so early failures cannot finish it */
+            size_t pending{1};
+
+            void Fail()
+            {
+                if (--pending == 0 && !this->finished)
+                {
+                    this->finished = true;
+                    this->inputs.clear();
+                    if (lastException)
+                    {
+                        promise.Reject(lastException);
+                    }
+                    else
+                    {
+                        promise.Resolve(Expected<T, E>{Unexpected<E>{std::move(lastError).value()}});
+                    }
+                }
+            }
+        };
+        auto result = std::make_shared<Result>();
+        result->Follow(result->promise);
+        if constexpr (std::ranges::sized_range<Range>)
+        {
+            result->inputs.reserve(std::ranges::size(promises));
+        }
+        size_t count = 0;
+        for (const Promise<Expected<T, E>> &promise : promises)
+        {
+            count++;
+            if (result->finished)
+            {
+                /** Decided by an earlier promise that had already succeeded */
+                promise.Cancel();
+                continue;
+            }
+            size_t i = result->inputs.size();
+            result->inputs.push_back(promise);
+            result->pending++;
+            promise.Then([=](Expected<T, E> outcome)
+                         {
+                if (result->finished)
+                {
+                    return;
+                }
+                if (outcome)
+                {
+                    /** The first to succeed wins, the rest are cancelled */
+                    result->Decide(i);
+                    result->promise.Resolve(std::move(outcome));
+                    return;
+                }
+                result->lastError.emplace(std::move(outcome).Error());
+                result->lastException = nullptr;
+                result->Fail(); });
+            promise.Catch([=](const std::exception_ptr &e)
+                          {
+                if (result->finished)
+                {
+                    return;
+                }
+                result->lastException = e;
+                result->lastError.reset();
+                result->Fail(); });
+        }
+        if (count == 0)
+        {
+            throw std::invalid_argument("Empty promises");
+        }
+        result->Fail();
+        return result->promise;
+    }
+
+} // namespace JS
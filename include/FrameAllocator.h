@@ -0,0 +1,243 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Coroutine frame allocation.
+ *
+ * By default frames come from the global allocator. There are two ways to change that:
+ * 1. Install a thread local default with ScopedFrameAllocator. Every coroutine created
+ *    on this thread while it is installed allocates from it.
+ * 2. Pass an allocator explicitly as the leading parameters of the coroutine:
+ *    JS::Promise<int> FooAsync(std::allocator_arg_t, JS::FrameAllocator &allocator, int arg);
+ *    The parameter types must be spelled exactly like this.
+ *    For member functions, these go right after the implicit object parameter.
+ *
+ * The allocator must outlive every frame allocated from it. C++ is not safe.
+ * That includes frames destroyed on another thread, e.g. a Task spawned on a Scheduler
+ * while a FramePool was installed and finished by another worker. FramePool serves only
+ * the thread that created it, and takes the global allocator on any other, so such a
+ * frame is freed with ::operator delete instead of racing on the owner's free lists.
+ */
+
+namespace JS
+{
+    struct FrameAllocator
+    {
+        virtual ~FrameAllocator() = default;
+        virtual void *Allocate(size_t size) = 0;
+        virtual void Deallocate(void *ptr, size_t size) = 0;
+
+        /**
+         * @brief The allocator used by coroutines without an explicit one on this thread.
+         *
+         * @return FrameAllocator* nullptr means the global allocator.
+         */
+        static FrameAllocator *Current()
+        {
+            return CurrentSlot();
+        }
+
+    private:
+        friend class ScopedFrameAllocator;
+        static FrameAllocator *&CurrentSlot()
+        {
+            static thread_local FrameAllocator *current = nullptr;
+            return current;
+        }
+    };
+
+    /**
+     * @brief Install an allocator as this thread's default for the lifetime of this object.
+     */
+    class ScopedFrameAllocator
+    {
+    public:
+        explicit ScopedFrameAllocator(FrameAllocator &allocator)
+            : _previous(std::exchange(FrameAllocator::CurrentSlot(), &allocator))
+        {
+        }
+
+        ~ScopedFrameAllocator()
+        {
+            FrameAllocator::CurrentSlot() = _previous;
+        }
+
+        ScopedFrameAllocator(const ScopedFrameAllocator &) = delete;
+        ScopedFrameAllocator &operator=(const ScopedFrameAllocator &) = delete;
+
+    private:
+        FrameAllocator *_previous;
+    };
+
+    /**
+     * @brief Size class free list pool. Freed frames are kept for reuse instead of going back to malloc.
+     * Only the thread that created it pools. Other threads allocate and free through the global allocator.
+     */
+    class FramePool : public FrameAllocator
+    {
+    public:
+        static constexpr size_t Granularity = 64;
+        static constexpr size_t MaxPooledSize = 4096;
+
+        FramePool() = default;
+        FramePool(const FramePool &) = delete;
+        FramePool &operator=(const FramePool &) = delete;
+
+        ~FramePool() override
+        {
+            for (size_t i = 0; i < _freeLists.size(); i++)
+            {
+                while (_freeLists[i])
+                {
+                    auto block = _freeLists[i];
+                    _freeLists[i] = block->next;
+                    ::operator delete(block, ClassSize(i));
+                }
+            }
+        }
+
+        void *Allocate(size_t size) override
+        {
+            if (size > MaxPooledSize)
+            {
+                return ::operator new(size);
+            }
+            size_t index = ClassIndex(size);
+            if (!IsOwner())
+            {
+                return ::operator new(ClassSize(index));
+            }
+            if (auto block = _freeLists[index])
+            {
+                _freeLists[index] = block->next;
+                return block;
+            }
+            return ::operator new(ClassSize(index));
+        }
+
+        void Deallocate(void *ptr, size_t size) override
+        {
+            if (size > MaxPooledSize)
+            {
+                ::operator delete(ptr, size);
+                return;
+            }
+            size_t index = ClassIndex(size);
+            /** Blocks are the same size whichever thread allocated them, so the owner may pool foreign ones */
+            if (!IsOwner())
+            {
+                ::operator delete(ptr, ClassSize(index));
+                return;
+            }
+            auto block = static_cast<FreeBlock *>(ptr);
+            block->next = _freeLists[index];
+            _freeLists[index] = block;
+        }
+
+    private:
+        struct FreeBlock
+        {
+            FreeBlock *next;
+        };
+
+        static constexpr size_t ClassIndex(size_t size)
+        {
+            return (size + Granularity - 1) / Granularity - 1;
+        }
+
+        static constexpr size_t ClassSize(size_t index)
+        {
+            return (index + 1) * Granularity;
+        }
+
+        bool IsOwner() const
+        {
+            return std::this_thread::get_id() == _owner;
+        }
+
+        std::array<FreeBlock *, MaxPooledSize / Granularity> _freeLists{};
+        std::thread::id _owner{std::this_thread::get_id()};
+    };
+
+    namespace Detail
+    {
+        /**
+         * Base for promise_type. Every frame is prefixed with the allocator it came from,
+         * so it can be returned to the right place when the frame is destroyed.
+         *
+         * Params are the coroutine's parameter types when it takes an explicit allocator.
+         * Those promise types are picked by the std::coroutine_traits specializations next to
+         * each coroutine type. The allocation function must not be a template, or gcc reports
+         * -Wmismatched-new-delete at every coroutine using it.
+         */
+        template <typename... Params>
+        struct FrameAllocated
+        {
+            static void *operator new(size_t size)
+                requires(sizeof...(Params) == 0)
+            {
+                return Allocate(size, FrameAllocator::Current());
+            }
+
+            static void *operator new(size_t size, Params &...params)
+                requires(sizeof...(Params) != 0)
+            {
+                return Allocate(size, FindAllocator(params...));
+            }
+
+            static void operator delete(void *ptr, size_t size)
+            {
+                auto header = static_cast<std::byte *>(ptr) - HeaderSize;
+                auto allocator = *reinterpret_cast<FrameAllocator **>(header);
+                if (allocator)
+                {
+                    allocator->Deallocate(header, size + HeaderSize);
+                }
+                else
+                {
+                    ::operator delete(header, size + HeaderSize);
+                }
+            }
+
+        private:
+            static constexpr size_t HeaderSize = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+            static_assert(HeaderSize >= sizeof(FrameAllocator *));
+
+            static void *Allocate(size_t size, FrameAllocator *allocator)
+            {
+                auto header = static_cast<std::byte *>(
+                    allocator ? allocator->Allocate(size + HeaderSize) : ::operator new(size + HeaderSize));
+                *reinterpret_cast<FrameAllocator **>(header) = allocator;
+                return header + HeaderSize;
+            }
+
+            /** The allocator is the parameter right after std::allocator_arg */
+            template <typename First, typename... Rest>
+            static FrameAllocator *FindAllocator(First &, Rest &...rest)
+            {
+                if constexpr (std::is_same_v<std::remove_cv_t<First>, std::allocator_arg_t>)
+                {
+                    return AllocatorAfterTag(rest...);
+                }
+                else
+                {
+                    return FindAllocator(rest...);
+                }
+            }
+
+            template <typename Next, typename... Rest>
+            static FrameAllocator *AllocatorAfterTag(Next &next, Rest &...)
+            {
+                return &next;
+            }
+        };
+    } // namespace Detail
+
+} // namespace JS
@@ -1,11 +1,22 @@
 #pragma once
 
 #include <coroutine>
-#include <functional>
+#include <cstdint>
+#include <exception>
 #include <memory>
 #include <optional>
+#include <ranges>
 #include <stdexcept>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <variant>
+#include <vector>
+#include "Callback.h"
+#include "Cancellation.h"
+#include "Executor.h"
+#include "FrameAllocator.h"
+#include "Ref.h"
 
 /**
  * Drawbacks compare to a real JavaScript Promise:
@@ -15,91 +26,449 @@
 
 namespace JS
 {
+    template <typename T>
+    struct Promise;
+
+    namespace Detail
+    {
+        /**
+         * Resumes the awaiting coroutine, if any. With an executor installed it is posted there,
+         * like any other resumption, so the executor's ordering holds across co_return.
+         * Without one it is a symmetric transfer instead of a nested resume(), and a chain of
+         * coroutines completing one another runs in constant stack space.
+         * gcc only emits the transfer as a tail call with -foptimize-sibling-calls (on from -O2).
+         * Also releases the reference held by the finished coroutine.
+         */
+        template <typename P>
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) const noexcept
+            {
+                std::coroutine_handle<> next = handle.promise().callingHandle;
+                /** This may destroy the frame, do not touch it afterwards. */
+                handle.promise().Release();
+                if (!next)
+                {
+                    return std::noop_coroutine();
+                }
+                if (auto executor = Executor::Current())
+                {
+                    executor->Post(next);
+                    return std::noop_coroutine();
+                }
+                return next;
+            }
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        /**
+         * The cancellation side of a promise state, the same for every Promise<T>.
+         * Costs no allocation until someone asks for a token.
+         */
+        struct PromiseCancellation
+        {
+            /** Allocated by the first Token() */
+            Ref<CancellationState> listeners{};
+            /** Cancelled along with this promise: the promise its coroutine awaits, or a combinator's inputs */
+            void (*cancelUpstream)(void *) = nullptr;
+            void *upstream = nullptr;
+            bool settled = false;
+            bool cancelled = false;
+            bool coroutine = false;
+
+            CancellationToken Token()
+            {
+                if (!listeners.Get())
+                {
+                    listeners = Ref<CancellationState>{new CancellationState()};
+                    listeners->cancelled = cancelled;
+                }
+                return CancellationToken{listeners};
+            }
+
+            /** @return bool Whether this is a plain promise left pending, which should reject itself */
+            bool RequestCancel()
+            {
+                if (settled || cancelled)
+                {
+                    return false;
+                }
+                cancelled = true;
+                if (listeners.Get())
+                {
+                    listeners->Cancel();
+                }
+                if (cancelUpstream)
+                {
+                    cancelUpstream(upstream);
+                }
+                return !coroutine && !settled;
+            }
+        };
+
+        template <typename T>
+        void OnCancel(const Promise<T> &promise, void (*cancel)(void *), void *context);
+
+        /**
+         * The inputs of Race, Any, AllExpected and AnyExpected, kept to cancel the losers.
+         * The inputs' callbacks hold the combinator and it holds the inputs,
+         * so they are let go as soon as the outcome is decided.
+         */
+        template <typename P>
+        struct Contenders
+        {
+            std::vector<P> inputs{};
+            bool finished = false;
+
+            /**
+             * @param winner Index of the input that decided, or SIZE_MAX to cancel them all.
+             * @return bool false if already decided.
+             */
+            bool Decide(size_t winner)
+            {
+                if (finished)
+                {
+                    return false;
+                }
+                finished = true;
+                auto losers = std::move(inputs);
+                for (size_t i = 0; i < losers.size(); i++)
+                {
+                    if (i != winner)
+                    {
+                        losers[i].Cancel();
+                    }
+                }
+                return true;
+            }
+
+            /** Cancelling the combinator's promise cancels every input. It settles before this goes away. */
+            template <typename U>
+            void Follow(const Promise<U> &promise)
+            {
+                OnCancel(promise, [](void *self)
+                         { static_cast<Contenders *>(self)->Decide(SIZE_MAX); },
+                         this);
+            }
+        };
+
+        template <typename U>
+        struct PromiseAwaiter;
+
+        /** The awaiter for awaitable, found like co_await does: member operator co_await, free operator co_await, or itself */
+        template <typename A>
+        decltype(auto) GetAwaiter(A &&awaitable)
+        {
+            if constexpr (requires { std::forward<A>(awaitable).operator co_await(); })
+            {
+                return std::forward<A>(awaitable).operator co_await();
+            }
+            else if constexpr (requires { operator co_await(std::forward<A>(awaitable)); })
+            {
+                return operator co_await(std::forward<A>(awaitable));
+            }
+            else
+            {
+                return std::forward<A>(awaitable);
+            }
+        }
+
+        /**
+         * Any other awaitable, passed through by reference, or holding what its operator co_await returned.
+         * Returning the reference itself from await_transform makes GCC 12 copy it.
+         */
+        template <typename A>
+        struct ForwardAwaiter
+        {
+            decltype(GetAwaiter(std::declval<A>())) awaiter;
+
+            bool await_ready()
+            {
+                return awaiter.await_ready();
+            }
+
+            template <typename H>
+            decltype(auto) await_suspend(H handle)
+            {
+                return awaiter.await_suspend(handle);
+            }
+
+            decltype(auto) await_resume()
+            {
+                return awaiter.await_resume();
+            }
+        };
+
+        struct TokenRequest
+        {
+        };
+
+        struct TokenAwaiter
+        {
+            CancellationToken token;
+
+            bool await_ready() const noexcept
+            {
+                return true;
+            }
+            void await_suspend(std::coroutine_handle<>) const noexcept
+            {
+            }
+            CancellationToken await_resume()
+            {
+                return std::move(token);
+            }
+        };
+
+        template <typename T>
+        struct IsPromise : std::false_type
+        {
+        };
+
+        template <typename T>
+        struct IsPromise<Promise<T>> : std::true_type
+        {
+        };
+    } // namespace Detail
+
+    /**
+     * @brief The outcome of one promise in AllSettled: a value or the exception it was rejected with.
+     * No larger than the value plus a tag. A null reason only appears before the promise settles.
+     */
+    template <typename T>
+    class Settled
+    {
+    public:
+        Settled() = default;
+
+        bool IsFulfilled() const
+        {
+            return _outcome.index() == 1;
+        }
+
+        bool IsRejected() const
+        {
+            return !IsFulfilled();
+        }
+
+        T &Value() &
+        {
+            return std::get<1>(_outcome);
+        }
+
+        const T &Value() const &
+        {
+            return std::get<1>(_outcome);
+        }
+
+        T &&Value() &&
+        {
+            return std::get<1>(std::move(_outcome));
+        }
+
+        /** Null if fulfilled */
+        std::exception_ptr Reason() const
+        {
+            return IsRejected() ? std::get<0>(_outcome) : nullptr;
+        }
+
+        void Fulfill(T &&value)
+        {
+            _outcome.template emplace<1>(std::move(value));
+        }
+
+        void Reject(std::exception_ptr reason)
+        {
+            _outcome.template emplace<0>(std::move(reason));
+        }
+
+    private:
+        std::variant<std::exception_ptr, T> _outcome{};
+    };
+
+    template <>
+    class Settled<void>
+    {
+    public:
+        Settled() = default;
+
+        bool IsFulfilled() const
+        {
+            return _reason == nullptr;
+        }
+
+        bool IsRejected() const
+        {
+            return _reason != nullptr;
+        }
+
+        std::exception_ptr Reason() const
+        {
+            return _reason;
+        }
+
+        void Reject(std::exception_ptr reason)
+        {
+            _reason = std::move(reason);
+        }
+
+    private:
+        std::exception_ptr _reason{nullptr};
+    };
+
     template <typename T>
     struct Promise
     {
-        struct State
+        struct State : Detail::RefCounted<State>, Detail::PromiseCancellation
         {
             std::optional<T> value;
             std::exception_ptr exception = nullptr;
             std::coroutine_handle<> callingHandle = nullptr;
-            std::function<void(T)> thenCallback = nullptr;
-            std::function<void(const std::exception &)> catchCallback = nullptr;
+            Callback<void(T)> thenCallback = nullptr;
+            Callback<void(const std::exception_ptr &)> catchCallback = nullptr;
+            /** Only the first settle counts, so a producer unaware of a cancel cannot resume twice */
             void Resolve(T &&v)
             {
-                value = std::move(v);
-                if (callingHandle)
+                if (std::exchange(settled, true))
                 {
-                    callingHandle.resume();
-                }
-                else if (thenCallback)
-                {
-                    auto temp = std::move(value.value());
-                    value.reset();
-                    thenCallback(std::move(temp));
+                    return;
                 }
+                value = std::move(v);
+                Notify();
             }
             void Resolve(const T &v)
             {
+                if (std::exchange(settled, true))
+                {
+                    return;
+                }
                 value = v;
-                if (callingHandle)
+                Notify();
+            }
+            void Reject(const std::exception_ptr &e)
+            {
+                if (std::exchange(settled, true))
                 {
-                    callingHandle.resume();
+                    return;
                 }
-                else if (thenCallback)
+                exception = e;
+                Notify();
+            }
+            void Reject(const std::string &reason)
+            {
+                Reject(std::make_exception_ptr(std::runtime_error(reason)));
+            }
+            void Cancel()
+            {
+                if (RequestCancel())
                 {
-                    auto temp = std::move(value.value());
-                    value.reset();
-                    thenCallback(std::move(temp));
+                    Reject(std::make_exception_ptr(CancelledError("Cancelled")));
                 }
             }
-            void Reject(const std::exception_ptr &e)
+            /** Resume the awaiting coroutine through the current executor, or run the callback if not awaited */
+            void Notify()
             {
-                exception = e;
                 if (callingHandle)
                 {
-                    callingHandle.resume();
+                    Detail::Resume(callingHandle);
                 }
-                else if (catchCallback)
+                else
                 {
-                    try
-                    {
-                        std::rethrow_exception(exception);
-                    }
-                    catch (const std::exception &ex)
-                    {
-                        catchCallback(ex);
-                    }
+                    RunCallbacks();
                 }
             }
-            void Reject(const std::string &reason)
+            void RunCallbacks()
             {
-                Reject(std::make_exception_ptr(std::runtime_error(reason)));
+                if (value.has_value())
+                {
+                    if (thenCallback)
+                    {
+                        auto temp = std::move(value.value());
+                        value.reset();
+                        thenCallback(std::move(temp));
+                    }
+                }
+                else if (exception && catchCallback)
+                {
+                    catchCallback(exception);
+                }
             }
         };
 
-        struct promise_type
+        /**
+         * The state is embedded in the coroutine frame, so a coroutine costs a single allocation.
+         * The frame is kept alive after completion until the last Promise referencing it is gone.
+         * Params is only used by coroutines taking an explicit frame allocator. See FrameAllocator.h.
+         */
+        template <typename... Params>
+        struct BasicPromiseType : State, Detail::FrameAllocated<Params...>
         {
-            std::shared_ptr<State> state = std::make_shared<State>();
+            BasicPromiseType()
+            {
+                /** The reference held by the running coroutine, released at final_suspend */
+                this->refCount = 1;
+                this->dispose = [](State *s)
+                { std::coroutine_handle<BasicPromiseType>::from_promise(*static_cast<BasicPromiseType *>(s)).destroy(); };
+                this->coroutine = true;
+            }
             Promise<T> get_return_object()
             {
-                return Promise{state};
+                return Promise{this};
             }
             std::suspend_never initial_suspend() { return {}; }
-            std::suspend_never final_suspend() noexcept { return {}; }
+            Detail::FinalAwaiter<BasicPromiseType> final_suspend() noexcept { return {}; }
+            /** An awaiting coroutine is resumed from final_suspend, callbacks run right away. */
             void return_value(T &&v)
             {
-                state->Resolve(std::move(v));
+                this->settled = true;
+                this->value = std::move(v);
+                if (!this->callingHandle)
+                {
+                    this->RunCallbacks();
+                }
             }
             void return_value(const T &v)
             {
-                state->Resolve(v);
+                this->settled = true;
+                this->value = v;
+                if (!this->callingHandle)
+                {
+                    this->RunCallbacks();
+                }
             }
             void unhandled_exception()
             {
-                state->Reject(std::current_exception());
+                this->settled = true;
+                this->exception = std::current_exception();
+                if (!this->callingHandle)
+                {
+                    this->RunCallbacks();
+                }
+            }
+            /** Awaited promises are cancelled along with this one. See Promise::Cancel. */
+            template <typename U>
+            Detail::PromiseAwaiter<U> await_transform(Promise<U> promise)
+            {
+                return Detail::PromiseAwaiter<U>{std::move(promise), *this};
+            }
+            Detail::TokenAwaiter await_transform(Detail::TokenRequest)
+            {
+                return Detail::TokenAwaiter{this->Token()};
+            }
+            template <typename A>
+                requires(!Detail::IsPromise<std::remove_cvref_t<A>>::value)
+            Detail::ForwardAwaiter<A> await_transform(A &&awaitable)
+            {
+                return Detail::ForwardAwaiter<A>{Detail::GetAwaiter(std::forward<A>(awaitable))};
             }
         };
+        using promise_type = BasicPromiseType<>;
 
         /**
          * @note DO NOT call this directly.
@@ -144,8 +513,8 @@ namespace JS
          * This is called when this is created as a coroutine.
          * Which should also be able to act as an awaitable.
          */
-        Promise(std::shared_ptr<State> state)
-            : _state(std::move(state))
+        Promise(State *state)
+            : _state(state)
         {
         }
 
@@ -154,7 +523,7 @@ namespace JS
          * Which will not act as a coroutine.
          */
         Promise()
-            : _state(std::make_shared<State>())
+            : _state(new State())
         {
         }
 
@@ -188,14 +557,35 @@ namespace JS
             _state->Reject(reason);
         }
 
-        void Then(std::function<void(T)> callback)
+        /**
+         * @brief Ask the work behind this promise to stop. Does nothing once it has settled.
+         *
+         * Callbacks registered on Token() run first. A coroutine then passes the cancel on to the
+         * promise it is awaiting, and to any promise it awaits later, so the innermost operation
+         * rejects and the CancelledError unwinds the chain. A plain promise that is still pending
+         * afterwards rejects itself with CancelledError, and later Resolve/Reject calls are ignored.
+         */
+        void Cancel() const
+        {
+            _state->Cancel();
+        }
+
+        /**
+         * @brief Cancelled when this promise is. Producers listen on it to stop their work.
+         */
+        CancellationToken Token() const
+        {
+            return _state->Token();
+        }
+
+        void Then(Callback<void(T)> callback) const
         {
             /** This should only be called if this is not awaited */
             if (_state->callingHandle)
             {
                 throw std::runtime_error("Promise is already awaited");
             }
-            _state->thenCallback = callback;
+            _state->thenCallback = std::move(callback);
             if (_state->value.has_value())
             {
                 auto temp = std::move(_state->value.value());
@@ -204,220 +594,419 @@ namespace JS
             }
         }
 
-        void Catch(std::function<void(const std::exception &)> callback)
+        /**
+         * @brief Handle the rejection with the original exception_ptr. Nothing is rethrown.
+         * Only for callbacks that cannot take a std::exception, so a generic [](auto &e) gets the std::exception.
+         */
+        template <typename F>
+            requires(!std::is_invocable_v<std::decay_t<F> &, const std::exception &> &&
+                     std::is_invocable_v<std::decay_t<F> &, const std::exception_ptr &>)
+        void Catch(F &&callback) const
         {
-            if (_state->callingHandle)
-            {
-                throw std::runtime_error("Promise is already awaited");
-            }
-            _state->catchCallback = callback;
-            if (_state->exception != nullptr)
-            {
+            SetCatchCallback(std::forward<F>(callback));
+        }
+
+        /**
+         * @brief Handle the rejection as a std::exception.
+         * This rethrows once to recover it, prefer the exception_ptr overload on hot paths.
+         */
+        template <typename F>
+            requires std::is_invocable_v<std::decay_t<F> &, const std::exception &>
+        void Catch(F &&callback) const
+        {
+            SetCatchCallback([callback = std::decay_t<F>(std::forward<F>(callback))](const std::exception_ptr &e) mutable
+                             {
                 try
                 {
-                    std::rethrow_exception(_state->exception);
+                    std::rethrow_exception(e);
                 }
-                catch (const std::exception &e)
+                catch (const std::exception &ex)
                 {
-                    _state->catchCallback(e);
-                }
-            }
+                    callback(ex);
+                } });
         }
 
         /**
          * @brief Wait for all promises to resolve or any to reject.
-         * @param promises
+         * @param promises Any input range of promises, e.g. a vector, std::span, std::array or a view.
          * @return Promise<std::vector<T>>
          */
-        static Promise<std::vector<T>> All(std::vector<Promise<T>> &promises)
+        template <std::ranges::input_range Range>
+            requires std::convertible_to<std::ranges::range_reference_t<Range>, const Promise<T> &>
+        static Promise<std::vector<T>> All(Range &&promises)
         {
-            if (promises.empty())
-            {
-                /** In JS, this will resolve []. We choose to forbid this. */
-                throw std::invalid_argument("Empty promises");
-            }
-            auto resultPromise = Promise<std::vector<T>>{};
             struct Result
             {
-                std::vector<T> values{};
-                size_t pending{};
+                Promise<std::vector<T>> promise{};
+                /** Optional slots, so T needs neither a default constructor nor a copy */
+                std::vector<std::optional<T>> values{};
+                /** One extra for the registration itself, so early resolves cannot finish it */
+                size_t pending{1};
                 bool rejected{};
+
+                void Complete()
+                {
+                    if (--pending != 0 || rejected)
+                    {
+                        return;
+                    }
+                    std::vector<T> results{};
+                    results.reserve(values.size());
+                    for (auto &slot : values)
+                    {
+                        results.push_back(std::move(slot).value());
+                    }
+                    promise.Resolve(std::move(results));
+                }
             };
             auto result = std::make_shared<Result>();
-            result->values.resize(promises.size());
-            result->pending = promises.size();
-            result->rejected = false;
-            for (size_t i = 0; i < promises.size(); ++i)
+            if constexpr (std::ranges::sized_range<Range>)
+            {
+                result->values.reserve(std::ranges::size(promises));
+            }
+            size_t i = 0;
+            for (const Promise<T> &promise : promises)
             {
-                promises[i].Then([=](const T &value)
-                                 {
+                result->values.emplace_back();
+                result->pending++;
+                promise.Then([=](T value)
+                             {
                 if (result->rejected)
                 {
                     return;
                 }
-                result->values[i] = value;
-                if (--(result->pending) == 0)
-                {
-                    resultPromise.Resolve(result->values);
-                } });
-                promises[i].Catch([=](const std::exception &e)
-                                  {      
+                result->values[i].emplace(std::move(value));
+                result->Complete(); });
+                promise.Catch([=](const std::exception_ptr &e)
+                              {      
                 if (result->rejected)
                 {
                     return;
                 }
                 result->rejected = true;
-                resultPromise.Reject(e.what()); });
+                result->promise.Reject(e); });
+                i++;
             }
-            return resultPromise;
-        }
-
-        static Promise<T> Any(std::vector<Promise<T>> &promises)
-        {
-            if (promises.empty())
+            if (i == 0)
             {
-                /** In JS, this will reject []. We choose to forbid this. */
+                /** In JS, this will resolve []. We choose to forbid this. */
                 throw std::invalid_argument("Empty promises");
             }
-            auto resultPromise = Promise<T>{};
-            struct Result
+            result->Complete();
+            return result->promise;
+        }
+
+        /**
+         * @brief Resolve with the first promise to resolve. The others are cancelled then.
+         */
+        template <std::ranges::input_range Range>
+            requires std::convertible_to<std::ranges::range_reference_t<Range>, const Promise<T> &>
+        static Promise<T> Any(Range &&promises)
+        {
+            struct Result : Detail::Contenders<Promise<T>>
             {
-                size_t pending{};
-                bool resolved{};
+                Promise<T> promise{};
+                /** One extra for the registration itself, so early rejects cannot finish it */
+                size_t pending{1};
+
+                void Fail()
+                {
+                    if (--pending == 0 && !this->finished)
+                    {
+                        this->finished = true;
+                        this->inputs.clear();
+                        /** Keep it a std::exception instead of a std::array */
+                        promise.Reject("All promises rejected");
+                    }
+                }
             };
             auto result = std::make_shared<Result>();
-            result->pending = promises.size();
-            result->resolved = false;
-            for (size_t i = 0; i < promises.size(); ++i)
+            result->Follow(result->promise);
+            if constexpr (std::ranges::sized_range<Range>)
             {
-                promises[i].Then([=](const T &value)
-                                 {
-                if (result->resolved)
-                {
-                    return;
-                }
-                result->resolved = true;
-                resultPromise.Resolve(value); });
-                promises[i].Catch([=](const std::exception &)
-                                  {      
-                if (result->resolved)
+                result->inputs.reserve(std::ranges::size(promises));
+            }
+            size_t count = 0;
+            for (const Promise<T> &promise : promises)
+            {
+                count++;
+                if (result->finished)
                 {
-                    return;
+                    /** Decided by an earlier promise that had already resolved */
+                    promise.Cancel();
+                    continue;
                 }
-                if (--(result->pending) == 0)
+                size_t i = result->inputs.size();
+                result->inputs.push_back(promise);
+                result->pending++;
+                promise.Then([=](T value)
+                             {
+                /** The first to resolve wins, the rest are cancelled */
+                if (result->Decide(i))
                 {
-                    /** Keep it a std::exception instead of a std::array */
-                    resultPromise.Reject("All promises rejected");
+                    result->promise.Resolve(std::move(value));
                 } });
+                promise.Catch([=](const std::exception_ptr &)
+                              {      
+                if (result->finished)
+                {
+                    return;
+                }
+                result->Fail(); });
+            }
+            if (count == 0)
+            {
+                /** In JS, this will reject []. We choose to forbid this. */
+                throw std::invalid_argument("Empty promises");
             }
-            return resultPromise;
+            result->Fail();
+            return result->promise;
         }
 
-        static Promise<T> Race(std::vector<Promise<T>> &promises)
+        /**
+         * @brief Wait for all promises to settle. Never rejects.
+         * Each outcome is written in place at the index of its promise.
+         * @param promises Any input range of promises.
+         * @return Promise<std::vector<Settled<T>>>
+         */
+        template <std::ranges::input_range Range>
+            requires std::convertible_to<std::ranges::range_reference_t<Range>, const Promise<T> &>
+        static Promise<std::vector<Settled<T>>> AllSettled(Range &&promises)
         {
-            if (promises.empty())
+            struct Result
+            {
+                Promise<std::vector<Settled<T>>> promise{};
+                std::vector<Settled<T>> outcomes{};
+                /** One extra for the registration itself, so early settles cannot finish it */
+                size_t pending{1};
+
+                void Complete()
+                {
+                    if (--pending == 0)
+                    {
+                        promise.Resolve(std::move(outcomes));
+                    }
+                }
+            };
+            auto result = std::make_shared<Result>();
+            if constexpr (std::ranges::sized_range<Range>)
+            {
+                result->outcomes.reserve(std::ranges::size(promises));
+            }
+            size_t i = 0;
+            for (const Promise<T> &promise : promises)
+            {
+                result->outcomes.emplace_back();
+                result->pending++;
+                promise.Then([=](T value)
+                             {
+                result->outcomes[i].Fulfill(std::move(value));
+                result->Complete(); });
+                promise.Catch([=](const std::exception_ptr &e)
+                              {
+                result->outcomes[i].Reject(e);
+                result->Complete(); });
+                i++;
+            }
+            if (i == 0)
             {
-                /** In JS, this will hang. We choose to forbid this. */
                 throw std::invalid_argument("Empty promises");
             }
-            auto resultPromise = Promise<T>{};
-            struct Result
+            result->Complete();
+            return result->promise;
+        }
+
+        /**
+         * @brief Settle like the first promise to settle. The others are cancelled then.
+         */
+        template <std::ranges::input_range Range>
+            requires std::convertible_to<std::ranges::range_reference_t<Range>, const Promise<T> &>
+        static Promise<T> Race(Range &&promises)
+        {
+            struct Result : Detail::Contenders<Promise<T>>
             {
-                bool finished{};
+                Promise<T> promise{};
             };
             auto result = std::make_shared<Result>();
-            result->finished = false;
-            for (size_t i = 0; i < promises.size(); i++)
+            result->Follow(result->promise);
+            if constexpr (std::ranges::sized_range<Range>)
             {
-                promises[i].Then([=](const T &value)
-                                 {
+                result->inputs.reserve(std::ranges::size(promises));
+            }
+            size_t count = 0;
+            for (const Promise<T> &promise : promises)
+            {
+                count++;
                 if (result->finished)
                 {
-                    return;
+                    /** Decided by an earlier promise that had already settled */
+                    promise.Cancel();
+                    continue;
                 }
-                result->finished = true;
-                resultPromise.Resolve(value); });
-                promises[i].Catch([=](const std::exception &e)
-                                  {      
-                if (result->finished)
+                size_t i = result->inputs.size();
+                result->inputs.push_back(promise);
+                /** The first to settle wins, the rest are cancelled */
+                promise.Then([=](T value)
+                             {
+                if (result->Decide(i))
                 {
-                    return;
-                }
-                result->finished = true;
-                resultPromise.Reject(e.what()); });
+                    result->promise.Resolve(std::move(value));
+                } });
+                promise.Catch([=](const std::exception_ptr &e)
+                              {      
+                if (result->Decide(i))
+                {
+                    result->promise.Reject(e);
+                } });
+            }
+            if (count == 0)
+            {
+                /** In JS, this will hang. We choose to forbid this. */
+                throw std::invalid_argument("Empty promises");
             }
-            return resultPromise;
+            return result->promise;
         }
 
     private:
-        std::shared_ptr<State> _state;
+        template <typename U>
+        friend struct Detail::PromiseAwaiter;
+        template <typename U>
+        friend void Detail::OnCancel(const Promise<U> &, void (*)(void *), void *);
+
+        void SetCatchCallback(Callback<void(const std::exception_ptr &)> callback) const
+        {
+            if (_state->callingHandle)
+            {
+                throw std::runtime_error("Promise is already awaited");
+            }
+            _state->catchCallback = std::move(callback);
+            if (_state->exception != nullptr)
+            {
+                _state->catchCallback(_state->exception);
+            }
+        }
+
+        Detail::Ref<State> _state;
     };
 
     template <>
     struct Promise<void>
     {
-        struct State
+        struct State : Detail::RefCounted<State>, Detail::PromiseCancellation
         {
             bool resolved = false;
             std::exception_ptr exception = nullptr;
             std::coroutine_handle<> callingHandle = nullptr;
-            std::function<void()> thenCallback = nullptr;
-            std::function<void(const std::exception &)> catchCallback = nullptr;
+            Callback<void()> thenCallback = nullptr;
+            Callback<void(const std::exception_ptr &)> catchCallback = nullptr;
             void Resolve()
             {
+                if (std::exchange(settled, true))
+                {
+                    return;
+                }
                 resolved = true;
-                if (callingHandle)
+                Notify();
+            }
+            void Reject(const std::exception_ptr &e)
+            {
+                if (std::exchange(settled, true))
                 {
-                    callingHandle.resume();
+                    return;
                 }
-                else if (thenCallback)
+                exception = e;
+                Notify();
+            }
+            void Reject(const std::string &reason)
+            {
+                Reject(std::make_exception_ptr(std::runtime_error(reason)));
+            }
+            void Cancel()
+            {
+                if (RequestCancel())
                 {
-                    thenCallback();
+                    Reject(std::make_exception_ptr(CancelledError("Cancelled")));
                 }
             }
-            void Reject(const std::exception_ptr &e)
+            /** Resume the awaiting coroutine through the current executor, or run the callback if not awaited */
+            void Notify()
             {
-                exception = e;
                 if (callingHandle)
                 {
-                    callingHandle.resume();
+                    Detail::Resume(callingHandle);
                 }
-                else if (catchCallback)
+                else
                 {
-                    try
-                    {
-                        std::rethrow_exception(exception);
-                    }
-                    catch (const std::exception &ex)
-                    {
-                        catchCallback(ex);
-                    }
+                    RunCallbacks();
                 }
             }
-            void Reject(const std::string &reason)
+            void RunCallbacks()
             {
-                Reject(std::make_exception_ptr(std::runtime_error(reason)));
+                if (resolved)
+                {
+                    if (thenCallback)
+                    {
+                        thenCallback();
+                    }
+                }
+                else if (exception && catchCallback)
+                {
+                    catchCallback(exception);
+                }
             }
         };
 
-        struct promise_type
+        template <typename... Params>
+        struct BasicPromiseType : State, Detail::FrameAllocated<Params...>
         {
-            std::shared_ptr<State> state{std::make_shared<State>()};
+            BasicPromiseType()
+            {
+                refCount = 1;
+                dispose = [](State *s)
+                { std::coroutine_handle<BasicPromiseType>::from_promise(*static_cast<BasicPromiseType *>(s)).destroy(); };
+                coroutine = true;
+            }
             Promise<void> get_return_object()
             {
-                return Promise{state};
+                return Promise{this};
             }
             std::suspend_never initial_suspend() { return {}; }
-            std::suspend_never final_suspend() noexcept { return {}; }
+            Detail::FinalAwaiter<BasicPromiseType> final_suspend() noexcept { return {}; }
             void return_void()
             {
-                state->Resolve();
+                settled = true;
+                resolved = true;
+                if (!callingHandle)
+                {
+                    RunCallbacks();
+                }
             }
             void unhandled_exception()
             {
-                state->Reject(std::current_exception());
+                settled = true;
+                exception = std::current_exception();
+                if (!callingHandle)
+                {
+                    RunCallbacks();
+                }
+            }
+            template <typename U>
+            Detail::PromiseAwaiter<U> await_transform(Promise<U> promise)
+            {
+                return Detail::PromiseAwaiter<U>{std::move(promise), *this};
+            }
+            Detail::TokenAwaiter await_transform(Detail::TokenRequest)
+            {
+                return Detail::TokenAwaiter{Token()};
+            }
+            template <typename A>
+                requires(!Detail::IsPromise<std::remove_cvref_t<A>>::value)
+            Detail::ForwardAwaiter<A> await_transform(A &&awaitable)
+            {
+                return Detail::ForwardAwaiter<A>{Detail::GetAwaiter(std::forward<A>(awaitable))};
             }
         };
+        using promise_type = BasicPromiseType<>;
 
         bool await_ready() const
         {
@@ -437,13 +1026,13 @@ namespace JS
             }
         }
 
-        Promise(std::shared_ptr<State> state)
-            : _state(std::move(state))
+        Promise(State *state)
+            : _state(state)
         {
         }
 
         Promise()
-            : _state(std::make_shared<State>())
+            : _state(new State())
         {
         }
 
@@ -462,154 +1051,457 @@ namespace JS
             _state->Reject(reason);
         }
 
-        void Then(std::function<void()> callback)
+        void Cancel() const
+        {
+            _state->Cancel();
+        }
+
+        CancellationToken Token() const
+        {
+            return _state->Token();
+        }
+
+        void Then(Callback<void()> callback) const
         {
             if (_state->callingHandle)
             {
                 throw std::runtime_error("Promise is already awaited");
             }
-            _state->thenCallback = callback;
+            _state->thenCallback = std::move(callback);
             if (_state->resolved)
             {
                 _state->thenCallback();
             }
         }
 
-        void Catch(std::function<void(const std::exception &)> callback)
+        /**
+         * @brief Handle the rejection with the original exception_ptr. Nothing is rethrown.
+         * Only for callbacks that cannot take a std::exception, so a generic [](auto &e) gets the std::exception.
+         */
+        template <typename F>
+            requires(!std::is_invocable_v<std::decay_t<F> &, const std::exception &> &&
+                     std::is_invocable_v<std::decay_t<F> &, const std::exception_ptr &>)
+        void Catch(F &&callback) const
         {
-            if (_state->callingHandle)
-            {
-                throw std::runtime_error("Promise is already awaited");
-            }
-            _state->catchCallback = callback;
-            if (_state->exception != nullptr)
-            {
+            SetCatchCallback(std::forward<F>(callback));
+        }
+
+        /**
+         * @brief Handle the rejection as a std::exception.
+         * This rethrows once to recover it, prefer the exception_ptr overload on hot paths.
+         */
+        template <typename F>
+            requires std::is_invocable_v<std::decay_t<F> &, const std::exception &>
+        void Catch(F &&callback) const
+        {
+            SetCatchCallback([callback = std::decay_t<F>(std::forward<F>(callback))](const std::exception_ptr &e) mutable
+                             {
                 try
                 {
-                    std::rethrow_exception(_state->exception);
+                    std::rethrow_exception(e);
                 }
-                catch (const std::exception &e)
+                catch (const std::exception &ex)
                 {
-                    _state->catchCallback(e);
-                }
-            }
+                    callback(ex);
+                } });
         }
 
-        static Promise<void> All(std::vector<Promise<void>> &promises)
+        template <std::ranges::input_range Range>
+            requires std::convertible_to<std::ranges::range_reference_t<Range>, const Promise<void> &>
+        static Promise<void> All(Range &&promises)
         {
-            if (promises.empty())
-            {
-                throw std::invalid_argument("Empty promises");
-            }
-            auto resultPromise = Promise<void>{};
             struct Result
             {
-                size_t pending{};
+                Promise<void> promise{};
+                size_t pending{1};
                 bool rejected{};
+
+                void Complete()
+                {
+                    if (--pending == 0 && !rejected)
+                    {
+                        promise.Resolve();
+                    }
+                }
             };
             auto result = std::make_shared<Result>();
-            result->pending = promises.size();
-            result->rejected = false;
-            for (size_t i = 0; i < promises.size(); ++i)
+            size_t count = 0;
+            for (const Promise<void> &promise : promises)
             {
-                promises[i].Then([=]()
-                                 {
+                result->pending++;
+                promise.Then([=]()
+                             {
                 if (result->rejected)
                 {
                     return;
                 }
-                if (--(result->pending) == 0)
-                {
-                    resultPromise.Resolve();
-                } });
-                promises[i].Catch([=](const std::exception &e)
-                                  {      
+                result->Complete(); });
+                promise.Catch([=](const std::exception_ptr &e)
+                              {      
                 if (result->rejected)
                 {
                     return;
                 }
                 result->rejected = true;
-                resultPromise.Reject(e.what()); });
+                result->promise.Reject(e); });
+                count++;
             }
-            return resultPromise;
-        }
-
-        static Promise<void> Any(std::vector<Promise<void>> &promises)
-        {
-            if (promises.empty())
+            if (count == 0)
             {
                 throw std::invalid_argument("Empty promises");
             }
-            auto resultPromise = Promise<void>{};
-            struct Result
+            result->Complete();
+            return result->promise;
+        }
+
+        template <std::ranges::input_range Range>
+            requires std::convertible_to<std::ranges::range_reference_t<Range>, const Promise<void> &>
+        static Promise<void> Any(Range &&promises)
+        {
+            struct Result : Detail::Contenders<Promise<void>>
             {
-                size_t pending{};
-                bool resolved{};
+                Promise<void> promise{};
+                size_t pending{1};
+
+                void Fail()
+                {
+                    if (--pending == 0 && !finished)
+                    {
+                        finished = true;
+                        inputs.clear();
+                        promise.Reject("All promises rejected");
+                    }
+                }
             };
             auto result = std::make_shared<Result>();
-            result->pending = promises.size();
-            result->resolved = false;
-            for (size_t i = 0; i < promises.size(); ++i)
+            result->Follow(result->promise);
+            if constexpr (std::ranges::sized_range<Range>)
+            {
+                result->inputs.reserve(std::ranges::size(promises));
+            }
+            size_t count = 0;
+            for (const Promise<void> &promise : promises)
             {
-                promises[i].Then([=]()
-                                 {
-                if (result->resolved)
+                count++;
+                if (result->finished)
                 {
-                    return;
+                    promise.Cancel();
+                    continue;
                 }
-                result->resolved = true;
-                resultPromise.Resolve(); });
-                promises[i].Catch([=](const std::exception &)
-                                  {      
-                if (result->resolved)
+                size_t i = result->inputs.size();
+                result->inputs.push_back(promise);
+                result->pending++;
+                promise.Then([=]()
+                             {
+                if (result->Decide(i))
+                {
+                    result->promise.Resolve();
+                } });
+                promise.Catch([=](const std::exception_ptr &)
+                              {      
+                if (result->finished)
                 {
                     return;
                 }
-                if (--(result->pending) == 0)
-                {
-                    resultPromise.Reject("All promises rejected");
-                } });
+                result->Fail(); });
             }
-            return resultPromise;
+            if (count == 0)
+            {
+                throw std::invalid_argument("Empty promises");
+            }
+            result->Fail();
+            return result->promise;
         }
 
-        static Promise<void> Race(std::vector<Promise<void>> &promises)
+        /**
+         * @brief Wait for all promises to settle. Never rejects.
+         * Each outcome is written in place at the index of its promise.
+         * @param promises Any input range of promises.
+         * @return Promise<std::vector<Settled<void>>>
+         */
+        template <std::ranges::input_range Range>
+            requires std::convertible_to<std::ranges::range_reference_t<Range>, const Promise<void> &>
+        static Promise<std::vector<Settled<void>>> AllSettled(Range &&promises)
         {
-            if (promises.empty())
+            struct Result
+            {
+                Promise<std::vector<Settled<void>>> promise{};
+                std::vector<Settled<void>> outcomes{};
+                /** One extra for the registration itself, so early settles cannot finish it */
+                size_t pending{1};
+
+                void Complete()
+                {
+                    if (--pending == 0)
+                    {
+                        promise.Resolve(std::move(outcomes));
+                    }
+                }
+            };
+            auto result = std::make_shared<Result>();
+            if constexpr (std::ranges::sized_range<Range>)
+            {
+                result->outcomes.reserve(std::ranges::size(promises));
+            }
+            size_t i = 0;
+            for (const Promise<void> &promise : promises)
+            {
+                result->outcomes.emplace_back();
+                result->pending++;
+                promise.Then([=]()
+                             {
+                result->Complete(); });
+                promise.Catch([=](const std::exception_ptr &e)
+                              {
+                result->outcomes[i].Reject(e);
+                result->Complete(); });
+                i++;
+            }
+            if (i == 0)
             {
                 throw std::invalid_argument("Empty promises");
             }
-            auto resultPromise = Promise<void>{};
-            struct Result
+            result->Complete();
+            return result->promise;
+        }
+
+        template <std::ranges::input_range Range>
+            requires std::convertible_to<std::ranges::range_reference_t<Range>, const Promise<void> &>
+        static Promise<void> Race(Range &&promises)
+        {
+            struct Result : Detail::Contenders<Promise<void>>
             {
-                bool finished{};
+                Promise<void> promise{};
             };
             auto result = std::make_shared<Result>();
-            result->finished = false;
-            for (size_t i = 0; i < promises.size(); i++)
+            result->Follow(result->promise);
+            if constexpr (std::ranges::sized_range<Range>)
             {
-                promises[i].Then([=]()
-                                 {
+                result->inputs.reserve(std::ranges::size(promises));
+            }
+            size_t count = 0;
+            for (const Promise<void> &promise : promises)
+            {
+                count++;
                 if (result->finished)
+                {
+                    promise.Cancel();
+                    continue;
+                }
+                size_t i = result->inputs.size();
+                result->inputs.push_back(promise);
+                promise.Then([=]()
+                             {
+                if (result->Decide(i))
+                {
+                    result->promise.Resolve();
+                } });
+                promise.Catch([=](const std::exception_ptr &e)
+                              {      
+                if (result->Decide(i))
+                {
+                    result->promise.Reject(e);
+                } });
+            }
+            if (count == 0)
+            {
+                throw std::invalid_argument("Empty promises");
+            }
+            return result->promise;
+        }
+
+    private:
+        template <typename U>
+        friend struct Detail::PromiseAwaiter;
+        template <typename U>
+        friend void Detail::OnCancel(const Promise<U> &, void (*)(void *), void *);
+
+        void SetCatchCallback(Callback<void(const std::exception_ptr &)> callback) const
+        {
+            if (_state->callingHandle)
+            {
+                throw std::runtime_error("Promise is already awaited");
+            }
+            _state->catchCallback = std::move(callback);
+            if (_state->exception != nullptr)
+            {
+                _state->catchCallback(_state->exception);
+            }
+        }
+
+        Detail::Ref<State> _state;
+    };
+
+    namespace Detail
+    {
+        /**
+         * How a Promise coroutine awaits another promise: while suspended, cancelling the
+         * coroutine's promise cancels the awaited one. If it is cancelled already, so is the awaited one.
+         */
+        template <typename U>
+        struct PromiseAwaiter
+        {
+            Promise<U> awaited;
+            PromiseCancellation &self;
+
+            bool await_ready() const
+            {
+                return awaited.await_ready();
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                if (self.cancelled)
+                {
+                    awaited.Cancel();
+                    if (awaited.await_ready())
+                    {
+                        return false;
+                    }
+                }
+                self.cancelUpstream = [](void *state)
+                { Promise<U>{static_cast<typename Promise<U>::State *>(state)}.Cancel(); };
+                self.upstream = awaited._state.Get();
+                awaited.await_suspend(handle);
+                return true;
+            }
+
+            U await_resume()
+            {
+                self.cancelUpstream = nullptr;
+                self.upstream = nullptr;
+                return awaited.await_resume();
+            }
+        };
+
+        /** Promise<void> contributes a std::monostate to a heterogeneous result */
+        template <typename T>
+        struct ResultOf
+        {
+            using Type = T;
+        };
+
+        template <>
+        struct ResultOf<void>
+        {
+            using Type = std::monostate;
+        };
+
+        /**
+         * The result promise's state and the per element slots in one allocation.
+         * The slot layout is fixed at compile time.
+         */
+        template <typename... T>
+        struct AllState : Promise<std::tuple<typename ResultOf<T>::Type...>>::State
+        {
+            using Base = typename Promise<std::tuple<typename ResultOf<T>::Type...>>::State;
+
+            std::tuple<std::optional<typename ResultOf<T>::Type>...> slots{};
+            size_t pending = sizeof...(T);
+            bool rejected = false;
+
+            AllState()
+            {
+                this->dispose = [](Base *s)
+                { delete static_cast<AllState *>(s); };
+            }
+
+            template <size_t I, typename... V>
+            void Fulfill(V &&...value)
+            {
+                if (rejected)
                 {
                     return;
                 }
-                result->finished = true;
-                resultPromise.Resolve(); });
-                promises[i].Catch([=](const std::exception &e)
-                                  {      
-                if (result->finished)
+                std::get<I>(slots).emplace(std::forward<V>(value)...);
+                if (--pending == 0)
+                {
+                    this->Resolve(std::apply([](auto &...slot)
+                                             { return std::tuple<typename ResultOf<T>::Type...>{std::move(*slot)...}; },
+                                             slots));
+                }
+            }
+
+            void Fail(const std::exception_ptr &e)
+            {
+                if (rejected)
                 {
                     return;
                 }
-                result->finished = true;
-                resultPromise.Reject(e.what()); });
+                rejected = true;
+                this->Reject(e);
+            }
+        };
+
+        template <size_t I, typename S, typename U>
+        void RegisterAll(const Ref<S> &state, Promise<U> &promise)
+        {
+            if constexpr (std::is_void_v<U>)
+            {
+                promise.Then([state]()
+                             { state->template Fulfill<I>(); });
             }
-            return resultPromise;
+            else
+            {
+                promise.Then([state](U value)
+                             { state->template Fulfill<I>(std::move(value)); });
+            }
+            promise.Catch([state](const std::exception_ptr &e)
+                          { state->Fail(e); });
         }
 
-    private:
-        std::shared_ptr<State> _state;
-    };
+        /**
+         * Stop whatever was going to settle a plain promise, like its timer, when it is cancelled
+         * before settling. context must stay valid until the promise settles.
+         */
+        template <typename T>
+        void OnCancel(const Promise<T> &promise, void (*cancel)(void *), void *context)
+        {
+            promise._state->cancelUpstream = cancel;
+            promise._state->upstream = context;
+        }
+    } // namespace Detail
+
+    /**
+     * @brief Inside a Promise coroutine, co_await this for a token cancelled along with the coroutine's promise.
+     * Useful to stop long running loops between awaits.
+     */
+    inline Detail::TokenRequest CurrentCancellationToken()
+    {
+        return {};
+    }
+
+    /**
+     * @brief Wait for all promises of different types to resolve or any to reject.
+     * Values are moved into the result. The whole combinator costs one allocation.
+     *
+     * @param promises
+     * @return Promise<std::tuple<T...>> Promise<void> contributes a std::monostate.
+     */
+    template <typename... T>
+    Promise<std::tuple<typename Detail::ResultOf<T>::Type...>> All(Promise<T>... promises)
+    {
+        static_assert(sizeof...(T) > 0, "Empty promises");
+        Detail::Ref<Detail::AllState<T...>> state{new Detail::AllState<T...>()};
+        Promise<std::tuple<typename Detail::ResultOf<T>::Type...>> resultPromise{state.Get()};
+        [&]<size_t... I>(std::index_sequence<I...>)
+        {
+            (Detail::RegisterAll<I>(state, promises), ...);
+        }(std::index_sequence_for<T...>{});
+        return resultPromise;
+    }
 
 } // namespace JS
+
+/** Coroutines taking an explicit frame allocator. See FrameAllocator.h */
+template <typename T, typename... Args>
+struct std::coroutine_traits<JS::Promise<T>, std::allocator_arg_t, JS::FrameAllocator &, Args...>
+{
+    using promise_type = typename JS::Promise<T>::template BasicPromiseType<std::allocator_arg_t, JS::FrameAllocator &, Args...>;
+};
+
+template <typename T, typename Self, typename... Args>
+struct std::coroutine_traits<JS::Promise<T>, Self, std::allocator_arg_t, JS::FrameAllocator &, Args...>
+{
+    using promise_type = typename JS::Promise<T>::template BasicPromiseType<Self, std::allocator_arg_t, JS::FrameAllocator &, Args...>;
+};
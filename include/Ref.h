@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+namespace JS
+{
+    namespace Detail
+    {
+        /**
+         * Intrusive, non-atomic reference count for the promise and cancellation states.
+         * A coroutine's state lives inside its frame, so dispose is swapped to destroy the frame.
+         */
+        template <typename S>
+        struct RefCounted
+        {
+            uint32_t refCount = 0;
+            void (*dispose)(S *) = [](S *s)
+            { delete s; };
+
+            void AddRef()
+            {
+                ++refCount;
+            }
+
+            void Release()
+            {
+                if (--refCount == 0)
+                {
+                    dispose(static_cast<S *>(this));
+                }
+            }
+        };
+
+        template <typename S>
+        class Ref
+        {
+        public:
+            Ref() = default;
+
+            explicit Ref(S *state) noexcept
+                : _ptr(state)
+            {
+                if (_ptr)
+                {
+                    _ptr->AddRef();
+                }
+            }
+
+            Ref(const Ref &other) noexcept
+                : Ref(other._ptr)
+            {
+            }
+
+            Ref(Ref &&other) noexcept
+                : _ptr(std::exchange(other._ptr, nullptr))
+            {
+            }
+
+            Ref &operator=(Ref other) noexcept
+            {
+                std::swap(_ptr, other._ptr);
+                return *this;
+            }
+
+            ~Ref()
+            {
+                if (_ptr)
+                {
+                    _ptr->Release();
+                }
+            }
+
+            S *operator->() const
+            {
+                return _ptr;
+            }
+
+            S *Get() const
+            {
+                return _ptr;
+            }
+
+        private:
+            S *_ptr = nullptr;
+        };
+    } // namespace Detail
+
+} // namespace JS
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace JS
+{
+    namespace Detail
+    {
+        /**
+         * A FIFO queue in one contiguous power of two ring, for the values an AsyncGenerator buffers.
+         * Unlike std::queue, it allocates only when it doubles, and pushing and popping touch
+         * neighbouring slots.
+         *
+         * With InlineCapacity 0 it grows on the heap. Otherwise it holds up to InlineCapacity values
+         * in place, never allocates, and Push throws std::length_error when full.
+         */
+        template <typename T, size_t InlineCapacity = 0>
+        class RingBuffer
+        {
+            static_assert(InlineCapacity == 0 || (InlineCapacity & (InlineCapacity - 1)) == 0,
+                          "InlineCapacity must be a power of two");
+
+        public:
+            RingBuffer() = default;
+
+            RingBuffer(RingBuffer &&other) noexcept(IsInline ? std::is_nothrow_move_constructible_v<T> : true)
+            {
+                if constexpr (IsInline)
+                {
+                    while (!other.Empty())
+                    {
+                        Push(std::move(other.Front()));
+                        other.Pop();
+                    }
+                }
+                else
+                {
+                    _storage = std::exchange(other._storage, {});
+                    _head = std::exchange(other._head, 0);
+                    _size = std::exchange(other._size, 0);
+                }
+            }
+
+            RingBuffer &operator=(RingBuffer &&other) noexcept(IsInline ? std::is_nothrow_move_constructible_v<T> : true)
+            {
+                if (this != &other)
+                {
+                    this->~RingBuffer();
+                    new (this) RingBuffer(std::move(other));
+                }
+                return *this;
+            }
+
+            RingBuffer(const RingBuffer &) = delete;
+            RingBuffer &operator=(const RingBuffer &) = delete;
+
+            ~RingBuffer()
+            {
+                Clear();
+                if constexpr (!IsInline)
+                {
+                    Deallocate(_storage);
+                }
+            }
+
+            bool Empty() const
+            {
+                return _size == 0;
+            }
+
+            size_t Size() const
+            {
+                return _size;
+            }
+
+            size_t Capacity() const
+            {
+                if constexpr (IsInline)
+                {
+                    return InlineCapacity;
+                }
+                else
+                {
+                    return _storage.capacity;
+                }
+            }
+
+            T &Front()
+            {
+                return Data()[_head];
+            }
+
+            const T &Front() const
+            {
+                return Data()[_head];
+            }
+
+            template <typename... Args>
+            T &Emplace(Args &&...args)
+            {
+                if (_size == Capacity())
+                {
+                    Grow();
+                }
+                T *slot = Data() + ((_head + _size) & (Capacity() - 1));
+                new (slot) T(std::forward<Args>(args)...);
+                _size++;
+                return *slot;
+            }
+
+            void Push(T &&value)
+            {
+                Emplace(std::move(value));
+            }
+
+            void Push(const T &value)
+            {
+                Emplace(value);
+            }
+
+            void Pop()
+            {
+                std::destroy_at(Data() + _head);
+                _head = (_head + 1) & (Capacity() - 1);
+                _size--;
+            }
+
+            void Clear()
+            {
+                while (!Empty())
+                {
+                    Pop();
+                }
+                _head = 0;
+            }
+
+        private:
+            static constexpr bool IsInline = InlineCapacity != 0;
+            static constexpr size_t InitialCapacity = 16;
+            /** Plain values grow with realloc, which can extend or remap the block instead of copying it */
+            static constexpr bool Reallocates = std::is_trivially_copyable_v<T> && alignof(T) <= alignof(std::max_align_t);
+
+            struct HeapStorage
+            {
+                T *data = nullptr;
+                size_t capacity = 0;
+            };
+
+            struct InlineStorage
+            {
+                alignas(T) std::byte bytes[sizeof(T) * (IsInline ? InlineCapacity : 1)];
+            };
+
+            T *Data()
+            {
+                if constexpr (IsInline)
+                {
+                    return std::launder(reinterpret_cast<T *>(_storage.bytes));
+                }
+                else
+                {
+                    return _storage.data;
+                }
+            }
+
+            const T *Data() const
+            {
+                return const_cast<RingBuffer *>(this)->Data();
+            }
+
+            static void Deallocate(HeapStorage storage)
+            {
+                if constexpr (Reallocates)
+                {
+                    std::free(storage.data);
+                }
+                else if (storage.data)
+                {
+                    std::allocator<T>{}.deallocate(storage.data, storage.capacity);
+                }
+            }
+
+            /** Double the ring */
+            void Grow()
+            {
+                if constexpr (IsInline)
+                {
+                    throw std::length_error("RingBuffer is full");
+                }
+                else if constexpr (Reallocates)
+                {
+                    size_t capacity = _storage.capacity ? _storage.capacity * 2 : InitialCapacity;
+                    auto data = static_cast<T *>(std::realloc(_storage.data, capacity * sizeof(T)));
+                    if (!data)
+                    {
+                        throw std::bad_alloc();
+                    }
+                    /** The ring is full, so the values before _head wrapped. They continue after the old end. */
+                    std::memcpy(static_cast<void *>(data + _storage.capacity), data, _head * sizeof(T));
+                    _storage = HeapStorage{data, capacity};
+                }
+                else
+                {
+                    /** Moved to the front of the new ring */
+                    size_t capacity = _storage.capacity ? _storage.capacity * 2 : InitialCapacity;
+                    T *data = std::allocator<T>{}.allocate(capacity);
+                    for (size_t i = 0; i < _size; i++)
+                    {
+                        T *from = _storage.data + ((_head + i) & (_storage.capacity - 1));
+                        new (data + i) T(std::move(*from));
+                        std::destroy_at(from);
+                    }
+                    Deallocate(_storage);
+                    _storage = HeapStorage{data, capacity};
+                    _head = 0;
+                }
+            }
+
+            std::conditional_t<IsInline, InlineStorage, HeapStorage> _storage{};
+            size_t _head = 0;
+            size_t _size = 0;
+        };
+    } // namespace Detail
+
+} // namespace JS
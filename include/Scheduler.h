@@ -0,0 +1,485 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Executor.h"
+#include "Task.h"
+#include "ThreadSafePromise.h"
+
+/**
+ * A work stealing thread pool for coroutines.
+ *
+ * co_await scheduler.Schedule() moves the calling coroutine onto the pool.
+ * scheduler.Spawn(task) starts a Task on the pool and returns a ThreadSafePromise for its result.
+ * Both push to the current worker's Chase-Lev deque, where idle workers steal from.
+ *
+ * Threading rules:
+ * 1. Promise and AsyncGenerator stay single threaded. A coroutine awaiting a Promise must be
+ *    resumed on the thread that resolves it, so workers keep those resumptions in a private queue
+ *    that is never stolen from.
+ * 2. Hand results between coroutines that may run on different threads with Spawn or ThreadSafePromise.
+ */
+
+namespace JS
+{
+    namespace Detail
+    {
+        /**
+         * Chase-Lev work stealing deque of coroutine handles.
+         * The owner pushes and pops at the bottom, thieves steal from the top.
+         * Memory orders follow "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al.).
+         */
+        class WorkStealingDeque
+        {
+        public:
+            WorkStealingDeque()
+            {
+                auto array = std::make_unique<Array>(InitialCapacity);
+                _array.store(array.get(), std::memory_order_relaxed);
+                _arrays.push_back(std::move(array));
+            }
+
+            WorkStealingDeque(const WorkStealingDeque &) = delete;
+            WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+            /** Owner only */
+            void Push(std::coroutine_handle<> handle)
+            {
+                int64_t bottom = _bottom.load(std::memory_order_relaxed);
+                int64_t top = _top.load(std::memory_order_acquire);
+                Array *array = _array.load(std::memory_order_relaxed);
+                if (bottom - top > static_cast<int64_t>(array->mask))
+                {
+                    array = Grow(array, top, bottom);
+                }
+                array->Put(bottom, handle.address());
+                /** Release, so a thief that sees the new bottom also sees the coroutine's frame */
+                _bottom.store(bottom + 1, std::memory_order_release);
+            }
+
+            /** Owner only. LIFO, so the most recently pushed, cache warm work runs first. */
+            std::coroutine_handle<> Pop()
+            {
+                int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+                Array *array = _array.load(std::memory_order_relaxed);
+                _bottom.store(bottom, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t top = _top.load(std::memory_order_relaxed);
+                if (top > bottom)
+                {
+                    _bottom.store(bottom + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                void *address = array->Get(bottom);
+                if (top == bottom)
+                {
+                    /** The last one, race the thieves for it */
+                    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    {
+                        address = nullptr;
+                    }
+                    _bottom.store(bottom + 1, std::memory_order_relaxed);
+                }
+                return std::coroutine_handle<>::from_address(address);
+            }
+
+            /** Any thread. FIFO. */
+            std::coroutine_handle<> Steal()
+            {
+                int64_t top = _top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t bottom = _bottom.load(std::memory_order_acquire);
+                if (top >= bottom)
+                {
+                    return nullptr;
+                }
+                Array *array = _array.load(std::memory_order_acquire);
+                void *address = array->Get(top);
+                if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    /** Lost to the owner or another thief */
+                    return nullptr;
+                }
+                return std::coroutine_handle<>::from_address(address);
+            }
+
+            /** Any thread, a hint only */
+            bool Empty() const
+            {
+                return _top.load(std::memory_order_acquire) >= _bottom.load(std::memory_order_acquire);
+            }
+
+        private:
+            static constexpr size_t InitialCapacity = 256;
+
+            struct Array
+            {
+                size_t mask;
+                std::unique_ptr<std::atomic<void *>[]> slots;
+
+                explicit Array(size_t capacity)
+                    : mask(capacity - 1), slots(new std::atomic<void *>[capacity])
+                {
+                }
+
+                void Put(int64_t index, void *address)
+                {
+                    slots[static_cast<size_t>(index) & mask].store(address, std::memory_order_relaxed);
+                }
+
+                void *Get(int64_t index) const
+                {
+                    return slots[static_cast<size_t>(index) & mask].load(std::memory_order_relaxed);
+                }
+            };
+
+            Array *Grow(Array *array, int64_t top, int64_t bottom)
+            {
+                auto grown = std::make_unique<Array>((array->mask + 1) * 2);
+                for (int64_t i = top; i < bottom; i++)
+                {
+                    grown->Put(i, array->Get(i));
+                }
+                _array.store(grown.get(), std::memory_order_release);
+                /** Thieves may still read the old array, so it is kept until the deque goes away */
+                _arrays.push_back(std::move(grown));
+                return _arrays.back().get();
+            }
+
+            alignas(64) std::atomic<int64_t> _top{0};
+            alignas(64) std::atomic<int64_t> _bottom{0};
+            std::atomic<Array *> _array{nullptr};
+            std::vector<std::unique_ptr<Array>> _arrays{};
+        };
+
+        /** A coroutine nobody waits for. It runs when posted and frees itself when done. */
+        struct Detached
+        {
+            struct promise_type
+            {
+                Detached get_return_object()
+                {
+                    return Detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+                std::suspend_always initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void()
+                {
+                }
+                void unhandled_exception()
+                {
+                    std::terminate();
+                }
+            };
+
+            std::coroutine_handle<> handle;
+        };
+    } // namespace Detail
+
+    class Scheduler : public Executor
+    {
+    public:
+        /**
+         * @param threadCount Number of worker threads.
+         */
+        explicit Scheduler(size_t threadCount = std::thread::hardware_concurrency())
+        {
+            threadCount = threadCount == 0 ? 1 : threadCount;
+            for (size_t i = 0; i < threadCount; i++)
+            {
+                _workers.push_back(std::make_unique<Worker>());
+                _workers.back()->random = static_cast<uint32_t>(i * 2654435761u + 1);
+            }
+            for (size_t i = 0; i < threadCount; i++)
+            {
+                _workers[i]->thread = std::thread([this, i]()
+                                                  { WorkerLoop(i); });
+            }
+        }
+
+        Scheduler(const Scheduler &) = delete;
+        Scheduler &operator=(const Scheduler &) = delete;
+
+        /**
+         * @brief Stops and joins the workers. Coroutines still queued are never resumed.
+         */
+        ~Scheduler() override
+        {
+            {
+                std::lock_guard lock{_mutex};
+                _stopping.store(true, std::memory_order_relaxed);
+            }
+            _wake.notify_all();
+            for (auto &worker : _workers)
+            {
+                worker->thread.join();
+            }
+        }
+
+        size_t ThreadCount() const
+        {
+            return _workers.size();
+        }
+
+        struct ScheduleAwaiter
+        {
+            Scheduler &scheduler;
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<> handle) const
+            {
+                scheduler.Push(handle);
+            }
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        /**
+         * @brief co_await this to continue on the pool, where any idle worker may pick it up.
+         */
+        ScheduleAwaiter Schedule()
+        {
+            return ScheduleAwaiter{*this};
+        }
+
+        /**
+         * @brief Start a task on the pool.
+         *
+         * @return ThreadSafePromise<T> Resolved with the task's result, on whichever worker finishes it.
+         */
+        template <typename T>
+        ThreadSafePromise<T> Spawn(Task<T> task)
+        {
+            ThreadSafePromise<T> promise{};
+            Push(RunDetached(std::move(task), promise).handle);
+            return promise;
+        }
+
+        /**
+         * @brief Resumptions from this pool's workers stay on the worker. Others go to the shared queue.
+         * See the threading rules above.
+         */
+        void Post(std::coroutine_handle<> handle) override
+        {
+            if (auto worker = CurrentWorker())
+            {
+                worker->local.push_back(handle);
+            }
+            else
+            {
+                Inject(handle);
+            }
+        }
+
+    private:
+        struct Worker
+        {
+            Detail::WorkStealingDeque deque{};
+            /** Resumptions posted by this worker, never stolen */
+            std::vector<std::coroutine_handle<>> local{};
+            std::vector<std::coroutine_handle<>> running{};
+            uint32_t random{};
+            std::thread thread{};
+        };
+
+        /** The worker running on this thread, tagged with its scheduler */
+        struct CurrentSlot
+        {
+            Scheduler *scheduler;
+            Worker *worker;
+        };
+
+        static CurrentSlot &ThisThread()
+        {
+            static thread_local CurrentSlot current{nullptr, nullptr};
+            return current;
+        }
+
+        Worker *CurrentWorker()
+        {
+            auto &current = ThisThread();
+            return current.scheduler == this ? current.worker : nullptr;
+        }
+
+        template <typename T>
+        static Detail::Detached RunDetached(Task<T> task, ThreadSafePromise<T> promise)
+        {
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    co_await task;
+                    promise.Resolve();
+                }
+                else
+                {
+                    promise.Resolve(co_await task);
+                }
+            }
+            catch (...)
+            {
+                promise.Reject(std::current_exception());
+            }
+        }
+
+        /** Stealable work */
+        void Push(std::coroutine_handle<> handle)
+        {
+            if (auto worker = CurrentWorker())
+            {
+                worker->deque.Push(handle);
+                WakeOne();
+            }
+            else
+            {
+                Inject(handle);
+            }
+        }
+
+        void Inject(std::coroutine_handle<> handle)
+        {
+            {
+                std::lock_guard lock{_mutex};
+                _injected.push_back(handle);
+                _hasInjected.store(true, std::memory_order_relaxed);
+            }
+            _wake.notify_one();
+        }
+
+        void WakeOne()
+        {
+            /** Pairs with the fence in Sleep, so either the sleeper sees the work or we see the sleeper */
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_sleeping.load(std::memory_order_relaxed) > 0)
+            {
+                std::lock_guard lock{_mutex};
+                _wake.notify_one();
+            }
+        }
+
+        std::coroutine_handle<> TakeInjected()
+        {
+            if (!_hasInjected.load(std::memory_order_relaxed))
+            {
+                return nullptr;
+            }
+            std::lock_guard lock{_mutex};
+            if (_injected.empty())
+            {
+                return nullptr;
+            }
+            auto handle = _injected.front();
+            _injected.pop_front();
+            _hasInjected.store(!_injected.empty(), std::memory_order_relaxed);
+            return handle;
+        }
+
+        std::coroutine_handle<> Steal(Worker &self)
+        {
+            size_t count = _workers.size();
+            /** xorshift, to spread thieves over victims */
+            self.random ^= self.random << 13;
+            self.random ^= self.random >> 17;
+            self.random ^= self.random << 5;
+            size_t start = self.random % count;
+            for (size_t i = 0; i < count; i++)
+            {
+                auto &victim = *_workers[(start + i) % count];
+                if (&victim == &self)
+                {
+                    continue;
+                }
+                if (auto handle = victim.deque.Steal())
+                {
+                    return handle;
+                }
+            }
+            return nullptr;
+        }
+
+        bool HasWork() const
+        {
+            if (_hasInjected.load(std::memory_order_relaxed))
+            {
+                return true;
+            }
+            for (auto &worker : _workers)
+            {
+                if (!worker->deque.Empty())
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Sleep()
+        {
+            std::unique_lock lock{_mutex};
+            _sleeping.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            _wake.wait(lock, [this]()
+                       { return _stopping.load(std::memory_order_relaxed) || HasWork(); });
+            _sleeping.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void WorkerLoop(size_t index)
+        {
+            auto &self = *_workers[index];
+            ThisThread() = CurrentSlot{this, &self};
+            ScopedExecutor scope{*this};
+            while (!_stopping.load(std::memory_order_relaxed))
+            {
+                if (!self.local.empty())
+                {
+                    std::swap(self.local, self.running);
+                    for (auto handle : self.running)
+                    {
+                        handle.resume();
+                    }
+                    self.running.clear();
+                    continue;
+                }
+                std::coroutine_handle<> handle = self.deque.Pop();
+                if (!handle)
+                {
+                    handle = TakeInjected();
+                }
+                if (!handle)
+                {
+                    handle = Steal(self);
+                }
+                if (handle)
+                {
+                    handle.resume();
+                    continue;
+                }
+                Sleep();
+            }
+            ThisThread() = CurrentSlot{nullptr, nullptr};
+        }
+
+        std::vector<std::unique_ptr<Worker>> _workers{};
+        std::mutex _mutex{};
+        std::condition_variable _wake{};
+        std::deque<std::coroutine_handle<>> _injected{};
+        std::atomic<bool> _hasInjected{false};
+        std::atomic<size_t> _sleeping{0};
+        std::atomic<bool> _stopping{false};
+    };
+
+} // namespace JS
@@ -0,0 +1,690 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "AsyncGenerator.h"
+#include "RingBuffer.h"
+
+/**
+ * Operators over AsyncGenerator, chained with |:
+ *
+ *   JS::AsyncGenerator<std::vector<int>> out = numbers
+ *       | JS::Filter([](const int &n) { return n % 2 == 0; })
+ *       | JS::Map([](int n) { return n * n; })
+ *       | JS::Take(100)
+ *       | JS::Chunk(10);
+ *
+ * The stages are fused at compile time into one pull loop. Converting the chain to an
+ * AsyncGenerator starts a single coroutine that awaits the source and runs each value through
+ * every stage inline, so a chain costs one frame and one hop per element, however many stages
+ * it has. The result buffers as much as the source does, see GeneratorCapacity.
+ *
+ * The source's return value is dropped. Once Take has what it needs, the source is no longer read.
+ *
+ * MapConcurrent maps through an async function instead, with several calls in flight.
+ * Merge reads several generators into one.
+ */
+
+namespace JS
+{
+    namespace Detail
+    {
+        /**
+         * A stage takes the values of the one before it.
+         * Push returns what to pass on, if anything. Done says no more input is needed.
+         * Flush is called until empty once the input ended, for anything held back.
+         */
+        template <typename In, typename F>
+        struct MapStage
+        {
+            using Out = std::remove_cvref_t<std::invoke_result_t<F &, In &&>>;
+            F f;
+
+            std::optional<Out> Push(In &&value)
+            {
+                return std::invoke(f, std::move(value));
+            }
+
+            bool Done() const
+            {
+                return false;
+            }
+
+            std::optional<Out> Flush()
+            {
+                return std::nullopt;
+            }
+        };
+
+        template <typename In, typename F>
+        struct FilterStage
+        {
+            using Out = In;
+            F f;
+
+            std::optional<Out> Push(In &&value)
+            {
+                if (!std::invoke(f, std::as_const(value)))
+                {
+                    return std::nullopt;
+                }
+                return std::move(value);
+            }
+
+            bool Done() const
+            {
+                return false;
+            }
+
+            std::optional<Out> Flush()
+            {
+                return std::nullopt;
+            }
+        };
+
+        template <typename In>
+        struct TakeStage
+        {
+            using Out = In;
+            size_t remaining;
+
+            std::optional<Out> Push(In &&value)
+            {
+                remaining--;
+                return std::move(value);
+            }
+
+            bool Done() const
+            {
+                return remaining == 0;
+            }
+
+            std::optional<Out> Flush()
+            {
+                return std::nullopt;
+            }
+        };
+
+        template <typename In>
+        struct ChunkStage
+        {
+            using Out = std::vector<In>;
+            size_t size;
+            std::vector<In> chunk{};
+
+            std::optional<Out> Push(In &&value)
+            {
+                if (chunk.empty())
+                {
+                    chunk.reserve(size);
+                }
+                chunk.push_back(std::move(value));
+                if (chunk.size() < size)
+                {
+                    return std::nullopt;
+                }
+                return std::exchange(chunk, {});
+            }
+
+            bool Done() const
+            {
+                return false;
+            }
+
+            /** The last, shorter chunk */
+            std::optional<Out> Flush()
+            {
+                if (chunk.empty())
+                {
+                    return std::nullopt;
+                }
+                return std::exchange(chunk, {});
+            }
+        };
+
+        /** Two stages run as one */
+        template <typename A, typename B>
+        struct ComposedStage
+        {
+            using Out = typename B::Out;
+            A a;
+            B b;
+
+            template <typename In>
+            std::optional<Out> Push(In &&value)
+            {
+                auto middle = a.Push(std::forward<In>(value));
+                if (!middle.has_value())
+                {
+                    return std::nullopt;
+                }
+                return b.Push(std::move(*middle));
+            }
+
+            bool Done() const
+            {
+                return a.Done() || b.Done();
+            }
+
+            std::optional<Out> Flush()
+            {
+                while (auto middle = a.Flush())
+                {
+                    if (auto out = b.Push(std::move(*middle)))
+                    {
+                        return out;
+                    }
+                }
+                return b.Flush();
+            }
+        };
+
+        /** What Map, Filter, Take and Chunk return, until | knows the type flowing in */
+        struct StreamOperator
+        {
+        };
+
+        template <typename F>
+        struct MapOperator : StreamOperator
+        {
+            F f;
+
+            template <typename In>
+            MapStage<In, F> Bind() &&
+            {
+                return MapStage<In, F>{std::move(f)};
+            }
+        };
+
+        template <typename F>
+        struct FilterOperator : StreamOperator
+        {
+            F f;
+
+            template <typename In>
+            FilterStage<In, F> Bind() &&
+            {
+                return FilterStage<In, F>{std::move(f)};
+            }
+        };
+
+        struct TakeOperator : StreamOperator
+        {
+            size_t count;
+
+            template <typename In>
+            TakeStage<In> Bind() &&
+            {
+                return TakeStage<In>{count};
+            }
+        };
+
+        struct ChunkOperator : StreamOperator
+        {
+            size_t size;
+
+            template <typename In>
+            ChunkStage<In> Bind() &&
+            {
+                return ChunkStage<In>{size};
+            }
+        };
+
+        template <typename Out, typename T, typename R, size_t N, typename Stage>
+        AsyncGenerator<Out> RunPipelineAsync(GeneratorCapacity capacity, AsyncGenerator<T, R, N> source, Stage stage)
+        {
+            (void)capacity;
+            while (!stage.Done())
+            {
+                auto value = co_await source.NextAsync();
+                if (!value.has_value())
+                {
+                    break;
+                }
+                if (auto out = stage.Push(std::move(*value)))
+                {
+                    co_yield std::move(*out);
+                }
+            }
+            while (auto out = stage.Flush())
+            {
+                co_yield std::move(*out);
+            }
+        }
+
+        /**
+         * A source and the stages piped after it, not running yet.
+         * Converting it to an AsyncGenerator starts it.
+         */
+        template <typename T, typename R, size_t N, typename Stage>
+        struct Pipeline
+        {
+            using Out = typename Stage::Out;
+            AsyncGenerator<T, R, N> source;
+            Stage stage;
+
+            operator AsyncGenerator<Out>() &&
+            {
+                GeneratorCapacity capacity{source._state->capacity};
+                return RunPipelineAsync<Out>(capacity, std::move(source), std::move(stage));
+            }
+        };
+
+        template <typename T, typename R, size_t N, std::derived_from<StreamOperator> Operator>
+        auto operator|(const AsyncGenerator<T, R, N> &source, Operator op)
+        {
+            using Stage = decltype(std::move(op).template Bind<T>());
+            return Pipeline<T, R, N, Stage>{source, std::move(op).template Bind<T>()};
+        }
+
+        /** Piping into a pipeline adds a stage instead of a coroutine */
+        template <typename T, typename R, size_t N, typename Stage, std::derived_from<StreamOperator> Operator>
+        auto operator|(Pipeline<T, R, N, Stage> &&pipeline, Operator op)
+        {
+            using Next = decltype(std::move(op).template Bind<typename Stage::Out>());
+            using Composed = ComposedStage<Stage, Next>;
+            return Pipeline<T, R, N, Composed>{
+                std::move(pipeline.source),
+                Composed{std::move(pipeline.stage), std::move(op).template Bind<typename Stage::Out>()}};
+        }
+
+        template <typename P>
+        struct PromiseValue;
+
+        template <typename U>
+        struct PromiseValue<Promise<U>>
+        {
+            using Type = U;
+        };
+
+        /** Shared by the coroutine reading the source, the calls in flight and the one yielding results */
+        template <typename U>
+        struct ConcurrentMapState
+        {
+            ConcurrentMapState(size_t limit, bool ordered)
+                : limit(limit), ordered(ordered), reorder(ordered ? limit : 0), calls(limit)
+            {
+                for (size_t slot = limit; slot > 0; slot--)
+                {
+                    freeCalls.push_back(slot - 1);
+                }
+            }
+
+            size_t limit;
+            bool ordered;
+            /** Results in the order they are to be yielded */
+            AsyncGenerator<U> results{};
+            /**
+             * Ordered results that finished before an earlier one, at their sequence number modulo limit.
+             * Fewer than limit calls separate the oldest from the newest, so they never collide.
+             */
+            std::vector<std::optional<U>> reorder;
+            size_t nextToFeed = 0;
+            /**
+             * Started and not yet handed to the consumer, so in flight, reordered, queued or buffered
+             * for yielding. The reader waits while this is at the limit.
+             */
+            size_t active = 0;
+            /** Started and not yet settled */
+            size_t running = 0;
+            /** The calls in flight, to cancel on failure, at slots taken from freeCalls */
+            std::vector<std::optional<Promise<U>>> calls;
+            std::vector<size_t> freeCalls{};
+            bool sourceDone = false;
+            bool failed = false;
+            /** Resolved when the reader, waiting at the limit, may go on */
+            std::optional<Promise<void>> room{};
+
+            /** @return size_t The slot of the call, to give back with Settled */
+            size_t Started(const Promise<U> &promise)
+            {
+                size_t slot = freeCalls.back();
+                freeCalls.pop_back();
+                calls[slot].emplace(promise);
+                active++;
+                running++;
+                return slot;
+            }
+
+            void Settled(size_t slot)
+            {
+                calls[slot].reset();
+                freeCalls.push_back(slot);
+                running--;
+            }
+
+            void Completed(size_t sequence, U &&value)
+            {
+                if (failed)
+                {
+                    return;
+                }
+                if (!ordered)
+                {
+                    results.Feed(std::move(value));
+                }
+                else
+                {
+                    reorder[sequence % limit].emplace(std::move(value));
+                    /** Feeding may run the consumer, which may complete more calls, so advance first */
+                    while (reorder[nextToFeed % limit].has_value())
+                    {
+                        auto &slot = reorder[nextToFeed % limit];
+                        auto next = std::move(*slot);
+                        slot.reset();
+                        nextToFeed++;
+                        results.Feed(std::move(next));
+                    }
+                }
+                MaybeFinish();
+            }
+
+            void Failed(const std::exception_ptr &e)
+            {
+                if (failed)
+                {
+                    return;
+                }
+                failed = true;
+                results.Reject(e);
+                WakeReader();
+                /** Copied first, as each cancelled call may settle and free its slot right away */
+                std::vector<Promise<U>> running{};
+                for (auto &call : calls)
+                {
+                    if (call.has_value())
+                    {
+                        running.push_back(*call);
+                    }
+                }
+                for (auto &call : running)
+                {
+                    call.Cancel();
+                }
+            }
+
+            /** A result was taken, another call may start */
+            void Release()
+            {
+                active--;
+                WakeReader();
+            }
+
+            void WakeReader()
+            {
+                if (room.has_value())
+                {
+                    auto promise = std::move(*room);
+                    room.reset();
+                    promise.Resolve();
+                }
+            }
+
+            void MaybeFinish()
+            {
+                if (sourceDone && running == 0 && !failed)
+                {
+                    results.Finish();
+                }
+            }
+        };
+
+        template <typename U, typename T, typename R, size_t N, typename F>
+        Promise<void> ReadConcurrentAsync(AsyncGenerator<T, R, N> source, F fn, std::shared_ptr<ConcurrentMapState<U>> state)
+        {
+            size_t sequence = 0;
+            try
+            {
+                while (!state->failed)
+                {
+                    if (state->active >= state->limit)
+                    {
+                        state->room.emplace();
+                        co_await *state->room;
+                        continue;
+                    }
+                    auto value = co_await source.NextAsync();
+                    if (!value.has_value() || state->failed)
+                    {
+                        break;
+                    }
+                    Promise<U> promise = std::invoke(fn, std::move(*value));
+                    size_t slot = state->Started(promise);
+                    promise.Then([state, sequence, slot](U result)
+                                 {
+                        state->Settled(slot);
+                        state->Completed(sequence, std::move(result)); });
+                    promise.Catch([state, slot](const std::exception_ptr &e)
+                                  {
+                        state->Settled(slot);
+                        state->Failed(e); });
+                    sequence++;
+                }
+            }
+            catch (...)
+            {
+                state->Failed(std::current_exception());
+            }
+            state->sourceDone = true;
+            state->MaybeFinish();
+        }
+
+        template <typename U, typename T, typename R, size_t N, typename F>
+        AsyncGenerator<U> MapConcurrentAsync(GeneratorCapacity capacity, AsyncGenerator<T, R, N> source, F fn, size_t limit, bool ordered)
+        {
+            (void)capacity;
+            auto state = std::make_shared<ConcurrentMapState<U>>(limit, ordered);
+            ReadConcurrentAsync<U>(std::move(source), std::move(fn), state);
+            while (auto result = co_await state->results.NextAsync())
+            {
+                /** With room for one, this resumes once the consumer took it. Only then is its slot free. */
+                co_yield std::move(*result);
+                state->Release();
+            }
+        }
+
+        /** Shared by the coroutines reading each source and the one yielding the merged values */
+        template <typename T>
+        struct MergeState
+        {
+            explicit MergeState(size_t sources)
+                : remaining(sources)
+            {
+                if (sources == 0)
+                {
+                    results.Finish();
+                }
+            }
+
+            /** Values in the order they arrived, at most one from each source */
+            AsyncGenerator<T> results{};
+            /** For each value in results, resolved when it is taken and its source may be read again */
+            RingBuffer<Promise<void>> taken{};
+            size_t remaining;
+            /** A source failed, the others are read no further */
+            bool stopped = false;
+
+            Promise<void> Arrive(T &&value)
+            {
+                /** Queued before feeding, as feeding may run the consumer, which takes it right away */
+                Promise<void> promise{};
+                taken.Push(promise);
+                results.Feed(std::move(value));
+                return promise;
+            }
+
+            /** The oldest value was taken */
+            void Release()
+            {
+                /** Values queued before a failure are still yielded, but Stop already let their readers go */
+                if (taken.Empty())
+                {
+                    return;
+                }
+                auto promise = std::move(taken.Front());
+                taken.Pop();
+                promise.Resolve();
+            }
+
+            void Ended()
+            {
+                remaining--;
+                if (remaining == 0 && !stopped)
+                {
+                    results.Finish();
+                }
+            }
+
+            void Failed(const std::exception_ptr &e)
+            {
+                if (stopped)
+                {
+                    return;
+                }
+                results.Reject(e);
+                Stop();
+            }
+
+            /** Let every waiting reader go, to see stopped and end */
+            void Stop()
+            {
+                stopped = true;
+                while (!taken.Empty())
+                {
+                    Release();
+                }
+            }
+        };
+
+        template <typename T, typename R, size_t N>
+        Promise<void> ReadMergedAsync(AsyncGenerator<T, R, N> source, std::shared_ptr<MergeState<T>> state)
+        {
+            try
+            {
+                while (!state->stopped)
+                {
+                    auto value = co_await source.NextAsync();
+                    if (!value.has_value() || state->stopped)
+                    {
+                        break;
+                    }
+                    /** One value in the queue at a time, so a busy source cannot crowd out the others */
+                    co_await state->Arrive(std::move(*value));
+                }
+            }
+            catch (...)
+            {
+                state->Failed(std::current_exception());
+            }
+            state->Ended();
+        }
+
+        template <typename T>
+        AsyncGenerator<T> MergeAsync(GeneratorCapacity capacity, std::shared_ptr<MergeState<T>> state)
+        {
+            (void)capacity;
+            while (auto value = co_await state->results.NextAsync())
+            {
+                state->Release();
+                co_yield std::move(*value);
+            }
+        }
+    } // namespace Detail
+
+    /**
+     * @brief Pass on f(value) for every value.
+     */
+    template <typename F>
+    Detail::MapOperator<std::decay_t<F>> Map(F &&f)
+    {
+        return {{}, std::forward<F>(f)};
+    }
+
+    /**
+     * @brief Pass on the values for which predicate(const value &) is true.
+     */
+    template <typename F>
+    Detail::FilterOperator<std::decay_t<F>> Filter(F &&predicate)
+    {
+        return {{}, std::forward<F>(predicate)};
+    }
+
+    /**
+     * @brief Pass on the first count values, then end the stream.
+     */
+    inline Detail::TakeOperator Take(size_t count)
+    {
+        return {{}, count};
+    }
+
+    /**
+     * @brief Pass on std::vector's of size values. The last one may be shorter.
+     */
+    inline Detail::ChunkOperator Chunk(size_t size)
+    {
+        if (size == 0)
+        {
+            throw std::invalid_argument("Chunk size must be at least 1");
+        }
+        return {{}, size};
+    }
+
+    /**
+     * @brief Map every value through fn, an async function returning a Promise, with up to limit calls in flight.
+     * The source is only read while fewer than limit values are in flight, held back for ordering,
+     * or buffered in the result, so limit bounds all of them together.
+     *
+     * @param ordered Yield in input order, holding back results that finish early. Otherwise in completion order.
+     * @return AsyncGenerator<U> Rejected by the first failure of the source or of fn. Calls in flight are then cancelled.
+     */
+    template <typename T, typename R, size_t N, typename F>
+    auto MapConcurrent(AsyncGenerator<T, R, N> source, F fn, size_t limit, bool ordered = true)
+    {
+        using U = typename Detail::PromiseValue<std::invoke_result_t<F &, T &&>>::Type;
+        if (limit == 0)
+        {
+            throw std::invalid_argument("Concurrency limit must be at least 1");
+        }
+        return Detail::MapConcurrentAsync<U>(GeneratorCapacity{1}, std::move(source), std::move(fn), limit, ordered);
+    }
+
+    /**
+     * @brief Yield the values of all sources as they come, in one generator.
+     * Each source is read one value ahead. Ready values are yielded in the order they arrived, so
+     * when several sources are ready they take turns, and a fast source cannot starve a slow one.
+     * Every value is yielded exactly once.
+     *
+     * @return AsyncGenerator<T> Ends when all sources have ended, or rejected by the first that fails.
+     * The return values of the sources are dropped.
+     */
+    template <typename T, typename... R, size_t... N>
+    AsyncGenerator<T> Merge(AsyncGenerator<T, R, N>... sources)
+    {
+        auto state = std::make_shared<Detail::MergeState<T>>(sizeof...(R));
+        (Detail::ReadMergedAsync(std::move(sources), state), ...);
+        return Detail::MergeAsync(GeneratorCapacity{1}, state);
+    }
+
+    /**
+     * @brief Merge, over a number of sources only known at run time.
+     */
+    template <typename T, typename R, size_t N>
+    AsyncGenerator<T> Merge(std::vector<AsyncGenerator<T, R, N>> sources)
+    {
+        auto state = std::make_shared<Detail::MergeState<T>>(sources.size());
+        for (auto &source : sources)
+        {
+            Detail::ReadMergedAsync(std::move(source), state);
+        }
+        return Detail::MergeAsync(GeneratorCapacity{1}, state);
+    }
+
+} // namespace JS
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "FrameAllocator.h"
+
+/**
+ * A lazy companion to Promise.
+ *
+ * A Task does not start until it is awaited. The result is kept in the coroutine frame,
+ * and the awaiting coroutine is resumed by symmetric transfer. So "call and immediately await"
+ * costs the frame allocation only.
+ *
+ * Differences from Promise:
+ * 1. Nothing runs until the Task is awaited. A Task that is never awaited never runs.
+ * 2. A Task is move only, and must be awaited at most once.
+ * 3. There is no Then/Catch. Use Promise for JS style fire and forget.
+ */
+
+namespace JS
+{
+    namespace Detail
+    {
+        /** Resumes the awaiting coroutine by symmetric transfer */
+        template <typename P>
+        struct TaskFinalAwaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) const noexcept
+            {
+                auto next = handle.promise().callingHandle;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() const noexcept
+            {
+            }
+        };
+    } // namespace Detail
+
+    template <typename T>
+    struct Task
+    {
+        struct State
+        {
+            std::optional<T> value{};
+            std::exception_ptr exception{nullptr};
+            std::coroutine_handle<> callingHandle{nullptr};
+        };
+
+        /** Params is only used by coroutines taking an explicit frame allocator. See FrameAllocator.h */
+        template <typename... Params>
+        struct BasicPromiseType : State, Detail::FrameAllocated<Params...>
+        {
+            Task<T> get_return_object()
+            {
+                return Task<T>{std::coroutine_handle<BasicPromiseType>::from_promise(*this), this};
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            Detail::TaskFinalAwaiter<BasicPromiseType> final_suspend() noexcept { return {}; }
+            void return_value(T &&v)
+            {
+                this->value = std::move(v);
+            }
+            void return_value(const T &v)
+            {
+                this->value = v;
+            }
+            void unhandled_exception()
+            {
+                this->exception = std::current_exception();
+            }
+        };
+        using promise_type = BasicPromiseType<>;
+
+        Task(Task &&other) noexcept
+            : _handle(std::exchange(other._handle, nullptr)), _state(std::exchange(other._state, nullptr))
+        {
+        }
+
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                _handle = std::exchange(other._handle, nullptr);
+                _state = std::exchange(other._state, nullptr);
+            }
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            Reset();
+        }
+
+        /**
+         * @note DO NOT call this directly.
+         */
+        bool await_ready() const
+        {
+            return _handle.done();
+        }
+
+        /**
+         * @note DO NOT call this directly.
+         *
+         * Starts the task by symmetric transfer.
+         * @param handle The calling coroutine's handle.
+         */
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle)
+        {
+            _state->callingHandle = handle;
+            return _handle;
+        }
+
+        /**
+         * @note DO NOT call this directly.
+         *
+         * @return T result of the task.
+         */
+        T await_resume()
+        {
+            if (_state->exception != nullptr)
+            {
+                std::rethrow_exception(_state->exception);
+            }
+            return std::move(_state->value).value();
+        }
+
+    private:
+        Task(std::coroutine_handle<> handle, State *state)
+            : _handle(handle), _state(state)
+        {
+        }
+
+        void Reset()
+        {
+            if (_handle)
+            {
+                std::exchange(_handle, nullptr).destroy();
+                _state = nullptr;
+            }
+        }
+
+        std::coroutine_handle<> _handle;
+        State *_state;
+    };
+
+    template <>
+    struct Task<void>
+    {
+        struct State
+        {
+            std::exception_ptr exception{nullptr};
+            std::coroutine_handle<> callingHandle{nullptr};
+        };
+
+        template <typename... Params>
+        struct BasicPromiseType : State, Detail::FrameAllocated<Params...>
+        {
+            Task<void> get_return_object()
+            {
+                return Task<void>{std::coroutine_handle<BasicPromiseType>::from_promise(*this), this};
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            Detail::TaskFinalAwaiter<BasicPromiseType> final_suspend() noexcept { return {}; }
+            void return_void()
+            {
+            }
+            void unhandled_exception()
+            {
+                exception = std::current_exception();
+            }
+        };
+        using promise_type = BasicPromiseType<>;
+
+        Task(Task &&other) noexcept
+            : _handle(std::exchange(other._handle, nullptr)), _state(std::exchange(other._state, nullptr))
+        {
+        }
+
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                _handle = std::exchange(other._handle, nullptr);
+                _state = std::exchange(other._state, nullptr);
+            }
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            Reset();
+        }
+
+        bool await_ready() const
+        {
+            return _handle.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle)
+        {
+            _state->callingHandle = handle;
+            return _handle;
+        }
+
+        void await_resume()
+        {
+            if (_state->exception != nullptr)
+            {
+                std::rethrow_exception(_state->exception);
+            }
+        }
+
+    private:
+        Task(std::coroutine_handle<> handle, State *state)
+            : _handle(handle), _state(state)
+        {
+        }
+
+        void Reset()
+        {
+            if (_handle)
+            {
+                std::exchange(_handle, nullptr).destroy();
+                _state = nullptr;
+            }
+        }
+
+        std::coroutine_handle<> _handle;
+        State *_state;
+    };
+
+} // namespace JS
+
+/** Coroutines taking an explicit frame allocator. See FrameAllocator.h */
+template <typename T, typename... Args>
+struct std::coroutine_traits<JS::Task<T>, std::allocator_arg_t, JS::FrameAllocator &, Args...>
+{
+    using promise_type = typename JS::Task<T>::template BasicPromiseType<std::allocator_arg_t, JS::FrameAllocator &, Args...>;
+};
+
+template <typename T, typename Self, typename... Args>
+struct std::coroutine_traits<JS::Task<T>, Self, std::allocator_arg_t, JS::FrameAllocator &, Args...>
+{
+    using promise_type = typename JS::Task<T>::template BasicPromiseType<Self, std::allocator_arg_t, JS::FrameAllocator &, Args...>;
+};
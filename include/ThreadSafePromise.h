@@ -0,0 +1,268 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "Executor.h"
+
+/**
+ * A promise that may be resolved from any thread.
+ *
+ * Meant for handing results of work offloaded to other threads back to a coroutine.
+ * The awaiting coroutine is never resumed on the resolving thread. It is posted to the executor
+ * that was installed on the awaiting thread when it suspended. See Executor.h.
+ * Awaiting a pending ThreadSafePromise without an installed executor throws std::logic_error,
+ * as there would be nowhere to resume but the resolving thread.
+ *
+ * Differences from Promise:
+ * 1. Only co_await is supported, there is no Then/Catch and no coroutine return type.
+ * 2. Only the first Resolve/Reject counts, later ones are ignored.
+ * 3. Pending, awaited and settled are tracked with a lock free atomic state machine,
+ *    and the reference count is atomic. So it costs a bit more than Promise.
+ */
+
+namespace JS
+{
+    namespace Detail
+    {
+        struct ThreadSafeStateBase
+        {
+            enum Phase : uint8_t
+            {
+                Pending,
+                Awaited,
+                Settled,
+            };
+
+            std::atomic<uint32_t> refCount{1};
+            std::atomic<uint8_t> phase{Pending};
+            /** Set by the first Resolve/Reject, so only one thread writes the result */
+            std::atomic_flag claimed{};
+            std::exception_ptr exception{nullptr};
+            std::coroutine_handle<> callingHandle{nullptr};
+            Executor *home{nullptr};
+
+            bool Claim()
+            {
+                return !claimed.test_and_set(std::memory_order_relaxed);
+            }
+
+            /** The result is written. Hand the awaiter to its executor if it is already waiting. */
+            void Publish()
+            {
+                if (phase.exchange(Settled, std::memory_order_acq_rel) != Awaited)
+                {
+                    return;
+                }
+                home->Post(callingHandle);
+            }
+
+            bool IsSettled() const
+            {
+                return phase.load(std::memory_order_acquire) == Settled;
+            }
+
+            /** @return false if the result came in meanwhile, so the caller should not suspend */
+            bool Suspend(std::coroutine_handle<> handle)
+            {
+                home = Executor::Current();
+                if (!home)
+                {
+                    throw std::logic_error("No executor installed on this thread to resume the ThreadSafePromise awaiter");
+                }
+                callingHandle = handle;
+                uint8_t expected = Pending;
+                return phase.compare_exchange_strong(expected, Awaited, std::memory_order_acq_rel, std::memory_order_acquire);
+            }
+        };
+
+        /** Like Ref, with an atomic count. */
+        template <typename S>
+        class AtomicRef
+        {
+        public:
+            AtomicRef()
+                : _ptr(new S())
+            {
+            }
+
+            AtomicRef(const AtomicRef &other) noexcept
+                : _ptr(other._ptr)
+            {
+                if (_ptr)
+                {
+                    _ptr->refCount.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            AtomicRef(AtomicRef &&other) noexcept
+                : _ptr(std::exchange(other._ptr, nullptr))
+            {
+            }
+
+            AtomicRef &operator=(AtomicRef other) noexcept
+            {
+                std::swap(_ptr, other._ptr);
+                return *this;
+            }
+
+            ~AtomicRef()
+            {
+                if (_ptr && _ptr->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete _ptr;
+                }
+            }
+
+            S *operator->() const
+            {
+                return _ptr;
+            }
+
+        private:
+            S *_ptr;
+        };
+    } // namespace Detail
+
+    template <typename T>
+    class ThreadSafePromise
+    {
+    public:
+        struct State : Detail::ThreadSafeStateBase
+        {
+            std::optional<T> value{};
+        };
+
+        ThreadSafePromise() = default;
+
+        /**
+         * @brief Resolve the promise from any thread. The value will be moved internally.
+         */
+        void Resolve(T &&v) const
+        {
+            if (_state->Claim())
+            {
+                _state->value.emplace(std::move(v));
+                _state->Publish();
+            }
+        }
+
+        void Resolve(const T &v) const
+        {
+            if (_state->Claim())
+            {
+                _state->value.emplace(v);
+                _state->Publish();
+            }
+        }
+
+        void Reject(const std::exception_ptr &e) const
+        {
+            if (_state->Claim())
+            {
+                _state->exception = e;
+                _state->Publish();
+            }
+        }
+
+        void Reject(const std::string &reason) const
+        {
+            Reject(std::make_exception_ptr(std::runtime_error(reason)));
+        }
+
+        /**
+         * @note DO NOT call this directly.
+         */
+        bool await_ready() const
+        {
+            return _state->IsSettled();
+        }
+
+        /**
+         * @note DO NOT call this directly.
+         *
+         * @param handle The calling coroutine's handle.
+         */
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            return _state->Suspend(handle);
+        }
+
+        /**
+         * @note DO NOT call this directly.
+         *
+         * @return T result of the awaitable.
+         */
+        T await_resume()
+        {
+            if (_state->exception != nullptr)
+            {
+                std::rethrow_exception(_state->exception);
+            }
+            return std::move(_state->value).value();
+        }
+
+    private:
+        Detail::AtomicRef<State> _state{};
+    };
+
+    template <>
+    class ThreadSafePromise<void>
+    {
+    public:
+        struct State : Detail::ThreadSafeStateBase
+        {
+        };
+
+        ThreadSafePromise() = default;
+
+        void Resolve() const
+        {
+            if (_state->Claim())
+            {
+                _state->Publish();
+            }
+        }
+
+        void Reject(const std::exception_ptr &e) const
+        {
+            if (_state->Claim())
+            {
+                _state->exception = e;
+                _state->Publish();
+            }
+        }
+
+        void Reject(const std::string &reason) const
+        {
+            Reject(std::make_exception_ptr(std::runtime_error(reason)));
+        }
+
+        bool await_ready() const
+        {
+            return _state->IsSettled();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            return _state->Suspend(handle);
+        }
+
+        void await_resume()
+        {
+            if (_state->exception != nullptr)
+            {
+                std::rethrow_exception(_state->exception);
+            }
+        }
+
+    private:
+        Detail::AtomicRef<State> _state{};
+    };
+
+} // namespace JS
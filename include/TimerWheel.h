@@ -0,0 +1,577 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "Callback.h"
+#include "Promise.h"
+
+/**
+ * A hierarchical timer wheel with millisecond ticks, for many concurrent timeouts.
+ *
+ * Setting and clearing a timeout is O(1) and does not allocate once the wheel has warmed up.
+ * Four levels of 256 slots cover about 49 days. A timer far away sits in a coarse slot and
+ * moves down a level each time the wheel passes that slot, until it fires from the first level.
+ *
+ * The wheel does not run by itself. Whoever owns it calls Advance with the current time, and
+ * sleeps until NextDeadline in between. EventLoop does that. With tev-cpp, a single tev timeout
+ * re-armed at NextDeadline after each Advance does the same.
+ *
+ * JS::Delay and JS::WithTimeout use the wheel installed on this thread with ScopedTimerWheel.
+ * EventLoop installs its own while it runs.
+ *
+ * Everything must be called from one thread.
+ */
+
+namespace JS
+{
+    /**
+     * @brief The rejection reason of JS::WithTimeout.
+     */
+    class TimeoutError : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    class TimerWheel
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using TimeoutHandle = uint64_t;
+
+        /**
+         * @param start Time of tick 0. Timeouts are rounded to whole ticks from here.
+         */
+        explicit TimerWheel(Clock::time_point start = Clock::now())
+            : _start(start)
+        {
+            _heads.fill(Nil);
+            _tails.fill(Nil);
+        }
+
+        TimerWheel(const TimerWheel &) = delete;
+        TimerWheel &operator=(const TimerWheel &) = delete;
+
+        /**
+         * @brief Call callback once, at the first Advance at least ms milliseconds after now.
+         * A 0 ms timeout fires at the next Advance.
+         *
+         * @return TimeoutHandle For ClearTimeout.
+         */
+        TimeoutHandle SetTimeout(Callback<void()> callback, uint64_t ms, Clock::time_point now = Clock::now())
+        {
+            uint32_t index = Allocate();
+            auto &node = _nodes[index];
+            node.callback = std::move(callback);
+            /** Rounded up, so a timer never fires early */
+            node.expiry = ms == 0 ? _tick : CeilTick(now) + ms;
+            if (node.expiry <= _tick)
+            {
+                Append(Due, index);
+            }
+            else
+            {
+                Place(index);
+            }
+            _size++;
+            return (static_cast<uint64_t>(node.generation) << 32) | index;
+        }
+
+        /**
+         * @brief Cancel a timeout. Handles of fired or cleared timeouts are ignored.
+         */
+        void ClearTimeout(TimeoutHandle handle)
+        {
+            uint32_t index = static_cast<uint32_t>(handle);
+            uint32_t generation = static_cast<uint32_t>(handle >> 32);
+            if (index < _nodes.size() && _nodes[index].bucket != Free && _nodes[index].generation == generation)
+            {
+                Unlink(index);
+                Release(index);
+            }
+        }
+
+        /**
+         * @brief Fire every timeout due at now, in deadline order.
+         * Timeouts set by the callbacks fire in a later Advance, even with 0 ms.
+         *
+         * @return size_t How many fired.
+         */
+        size_t Advance(Clock::time_point now)
+        {
+            size_t fired = 0;
+            /** Only the ones due before this call. They may still be cleared while others fire. */
+            Redistribute(Due, Firing);
+            while (_heads[Firing] != Nil)
+            {
+                uint32_t index = _heads[Firing];
+                Unlink(index);
+                Fire(index);
+                fired++;
+            }
+            uint64_t target = FloorTick(now);
+            while (_tick < target)
+            {
+                _tick = NextInterestingTick(target);
+                Cascade();
+                size_t bucket = _tick & SlotMask;
+                while (_heads[bucket] != Nil)
+                {
+                    uint32_t index = _heads[bucket];
+                    Unlink(index);
+                    Fire(index);
+                    fired++;
+                }
+            }
+            return fired;
+        }
+
+        /**
+         * @brief When to call Advance next.
+         * Timeouts beyond the first level report when they move down, which may be earlier
+         * than they fire. Advancing then costs little and gives the next estimate.
+         *
+         * @return std::optional<Clock::time_point> nullopt if there are no timeouts.
+         */
+        std::optional<Clock::time_point> NextDeadline() const
+        {
+            if (_size == 0)
+            {
+                return std::nullopt;
+            }
+            if (_heads[Due] != Nil)
+            {
+                return TimeOf(_tick);
+            }
+            for (size_t level = 0; level < Levels; level++)
+            {
+                size_t shift = level * SlotBits;
+                auto slot = NextOccupied(level, (_tick >> shift) & SlotMask);
+                if (slot)
+                {
+                    uint64_t above = (_tick >> shift >> SlotBits) << SlotBits;
+                    return TimeOf((above | *slot) << shift);
+                }
+            }
+            return TimeOf(((_tick >> (Levels * SlotBits)) + 1) << (Levels * SlotBits));
+        }
+
+        bool Empty() const
+        {
+            return _size == 0;
+        }
+
+        size_t Size() const
+        {
+            return _size;
+        }
+
+        /**
+         * @brief The wheel installed on this thread.
+         *
+         * @return TimerWheel* nullptr if none.
+         */
+        static TimerWheel *Current()
+        {
+            return CurrentSlot();
+        }
+
+    private:
+        friend class ScopedTimerWheel;
+
+        static constexpr size_t SlotBits = 8;
+        static constexpr size_t Slots = size_t{1} << SlotBits;
+        static constexpr size_t SlotMask = Slots - 1;
+        static constexpr size_t Levels = 4;
+        /** Timeouts that are already due */
+        static constexpr size_t Due = Levels * Slots;
+        /** Timeouts beyond the last level, looked at again each time it wraps */
+        static constexpr size_t Overflow = Due + 1;
+        /** The due timeouts the current Advance fires */
+        static constexpr size_t Firing = Overflow + 1;
+        static constexpr uint16_t Free = Firing + 1;
+        static constexpr uint32_t Nil = UINT32_MAX;
+
+        struct Node
+        {
+            Callback<void()> callback{};
+            uint64_t expiry{};
+            uint32_t prev{Nil};
+            uint32_t next{Nil};
+            uint32_t generation{};
+            uint16_t bucket{Free};
+        };
+
+        static TimerWheel *&CurrentSlot()
+        {
+            static thread_local TimerWheel *current = nullptr;
+            return current;
+        }
+
+        uint64_t FloorTick(Clock::time_point time) const
+        {
+            if (time <= _start)
+            {
+                return 0;
+            }
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(time - _start).count());
+        }
+
+        uint64_t CeilTick(Clock::time_point time) const
+        {
+            if (time <= _start)
+            {
+                return 0;
+            }
+            return static_cast<uint64_t>(std::chrono::ceil<std::chrono::milliseconds>(time - _start).count());
+        }
+
+        Clock::time_point TimeOf(uint64_t tick) const
+        {
+            return _start + std::chrono::milliseconds(tick);
+        }
+
+        uint32_t Allocate()
+        {
+            if (_free != Nil)
+            {
+                return std::exchange(_free, _nodes[_free].next);
+            }
+            _nodes.emplace_back();
+            return static_cast<uint32_t>(_nodes.size() - 1);
+        }
+
+        void Release(uint32_t index)
+        {
+            auto &node = _nodes[index];
+            node.callback = nullptr;
+            node.generation++;
+            node.bucket = Free;
+            node.next = std::exchange(_free, index);
+            _size--;
+        }
+
+        /**
+         * The level is the highest 8 bit digit where the expiry differs from the current tick,
+         * so the slot is always ahead of the wheel's position on that level. A timeout cascading
+         * into the tick being fired goes to its slot, which fires right after.
+         */
+        void Place(uint32_t index)
+        {
+            uint64_t expiry = _nodes[index].expiry;
+            if (expiry <= _tick)
+            {
+                Append(_tick & SlotMask, index);
+                return;
+            }
+            size_t level = static_cast<size_t>(std::bit_width(expiry ^ _tick) - 1) / SlotBits;
+            if (level >= Levels)
+            {
+                Append(Overflow, index);
+                return;
+            }
+            Append(level * Slots + ((expiry >> (level * SlotBits)) & SlotMask), index);
+        }
+
+        void Append(size_t bucket, uint32_t index)
+        {
+            auto &node = _nodes[index];
+            node.bucket = static_cast<uint16_t>(bucket);
+            node.prev = _tails[bucket];
+            node.next = Nil;
+            if (_tails[bucket] == Nil)
+            {
+                _heads[bucket] = index;
+                if (bucket < Due)
+                {
+                    _occupied[bucket / Slots][(bucket & SlotMask) / 64] |= uint64_t{1} << (bucket & 63);
+                }
+            }
+            else
+            {
+                _nodes[_tails[bucket]].next = index;
+            }
+            _tails[bucket] = index;
+        }
+
+        void Unlink(uint32_t index)
+        {
+            auto &node = _nodes[index];
+            size_t bucket = node.bucket;
+            (node.prev == Nil ? _heads[bucket] : _nodes[node.prev].next) = node.next;
+            (node.next == Nil ? _tails[bucket] : _nodes[node.next].prev) = node.prev;
+            if (_heads[bucket] == Nil && bucket < Due)
+            {
+                _occupied[bucket / Slots][(bucket & SlotMask) / 64] &= ~(uint64_t{1} << (bucket & 63));
+            }
+        }
+
+        void Fire(uint32_t index)
+        {
+            /** Moved out first, the callback may set timeouts and grow the node pool */
+            auto callback = std::move(_nodes[index].callback);
+            Release(index);
+            callback();
+        }
+
+        bool LevelEmpty(size_t level) const
+        {
+            auto &words = _occupied[level];
+            return (words[0] | words[1] | words[2] | words[3]) == 0;
+        }
+
+        /** The next slot after position on this level that holds timeouts */
+        std::optional<size_t> NextOccupied(size_t level, size_t position) const
+        {
+            for (size_t slot = position + 1; slot < Slots;)
+            {
+                uint64_t word = _occupied[level][slot / 64] >> (slot & 63);
+                if (word != 0)
+                {
+                    return slot + static_cast<size_t>(std::countr_zero(word));
+                }
+                slot = (slot | 63) + 1;
+            }
+            return std::nullopt;
+        }
+
+        /** The next tick where a slot fires or cascades. Empty stretches are skipped at once. */
+        uint64_t NextInterestingTick(uint64_t target) const
+        {
+            size_t empty = 0;
+            while (empty < Levels && LevelEmpty(empty))
+            {
+                empty++;
+            }
+            if (empty == 0)
+            {
+                return _tick + 1;
+            }
+            if (empty == Levels && _heads[Overflow] == Nil)
+            {
+                return target;
+            }
+            /** Nothing happens before the next carry into the lowest non empty level */
+            size_t shift = empty * SlotBits;
+            return std::min(target, ((_tick >> shift) + 1) << shift);
+        }
+
+        /** Move the timeouts of the slots the wheel just reached down, coarsest level first */
+        void Cascade()
+        {
+            if ((_tick & ((uint64_t{1} << (Levels * SlotBits)) - 1)) == 0)
+            {
+                Redistribute(Overflow, Overflow);
+            }
+            for (size_t level = Levels - 1; level > 0; level--)
+            {
+                size_t shift = level * SlotBits;
+                if ((_tick & ((uint64_t{1} << shift) - 1)) == 0)
+                {
+                    size_t bucket = level * Slots + ((_tick >> shift) & SlotMask);
+                    Redistribute(bucket, bucket);
+                }
+            }
+        }
+
+        /** Empty a bucket, placing its timeouts anew, or all into another bucket. Keeps their order. */
+        void Redistribute(size_t bucket, size_t into)
+        {
+            uint32_t index = std::exchange(_heads[bucket], Nil);
+            _tails[bucket] = Nil;
+            if (bucket < Due)
+            {
+                _occupied[bucket / Slots][(bucket & SlotMask) / 64] &= ~(uint64_t{1} << (bucket & 63));
+            }
+            while (index != Nil)
+            {
+                uint32_t next = _nodes[index].next;
+                if (into == bucket)
+                {
+                    Place(index);
+                }
+                else
+                {
+                    Append(into, index);
+                }
+                index = next;
+            }
+        }
+
+        Clock::time_point _start;
+        /** Every tick up to and including this one has fired */
+        uint64_t _tick{};
+        size_t _size{};
+        std::vector<Node> _nodes{};
+        uint32_t _free{Nil};
+        std::array<uint32_t, Firing + 1> _heads{};
+        std::array<uint32_t, Firing + 1> _tails{};
+        std::array<std::array<uint64_t, Slots / 64>, Levels> _occupied{};
+    };
+
+    /**
+     * @brief Install a wheel as this thread's wheel for the lifetime of this object.
+     */
+    class ScopedTimerWheel
+    {
+    public:
+        explicit ScopedTimerWheel(TimerWheel &wheel)
+            : _previous(std::exchange(TimerWheel::CurrentSlot(), &wheel))
+        {
+        }
+
+        ~ScopedTimerWheel()
+        {
+            TimerWheel::CurrentSlot() = _previous;
+        }
+
+        ScopedTimerWheel(const ScopedTimerWheel &) = delete;
+        ScopedTimerWheel &operator=(const ScopedTimerWheel &) = delete;
+
+    private:
+        TimerWheel *_previous;
+    };
+
+    namespace Detail
+    {
+        inline TimerWheel &CurrentTimerWheel()
+        {
+            auto wheel = TimerWheel::Current();
+            if (!wheel)
+            {
+                throw std::logic_error("No TimerWheel installed on this thread");
+            }
+            return *wheel;
+        }
+
+        /** Where a Delay's timer is, to clear it when the promise is cancelled. Owned by the timer. */
+        struct DelayTimer
+        {
+            TimerWheel *wheel;
+            TimerWheel::TimeoutHandle handle;
+        };
+
+        inline Promise<void> DelayOn(TimerWheel &wheel, uint64_t ms, TimerWheel::Clock::time_point now)
+        {
+            Promise<void> promise{};
+            auto timer = std::make_unique<DelayTimer>(DelayTimer{&wheel, 0});
+            DelayTimer *context = timer.get();
+            context->handle = wheel.SetTimeout([promise, timer = std::move(timer)]()
+                                               { promise.Resolve(); },
+                                               ms, now);
+            /** Clearing the timer destroys the callback, and the DelayTimer with it */
+            OnCancel(promise, [](void *context)
+                     {
+                auto timer = static_cast<DelayTimer *>(context);
+                timer->wheel->ClearTimeout(timer->handle); },
+                     context);
+            return promise;
+        }
+    } // namespace Detail
+
+    /**
+     * @brief A promise resolved after ms milliseconds, on this thread's TimerWheel.
+     * Cancelling the promise clears the timer.
+     */
+    inline Promise<void> Delay(uint64_t ms)
+    {
+        return Detail::DelayOn(Detail::CurrentTimerWheel(), ms, TimerWheel::Clock::now());
+    }
+
+    /**
+     * @brief Settle like promise, or reject with TimeoutError if it takes more than ms milliseconds.
+     * The timeout is cleared as soon as promise settles. On timeout, promise is cancelled.
+     * Cancelling the result cancels promise and clears the timeout.
+     *
+     * @param promise Consumed, like by the combinators.
+     * @return Promise<T>
+     */
+    template <typename T>
+    Promise<T> WithTimeout(const Promise<T> &promise, uint64_t ms)
+    {
+        struct Result
+        {
+            Promise<T> promise{};
+            /** Kept until it settles or times out, to be cancelled */
+            std::optional<Promise<T>> input{};
+            TimerWheel *wheel{};
+            TimerWheel::TimeoutHandle timeout{};
+            bool finished{};
+
+            /** @return false if the other side already won */
+            bool Finish()
+            {
+                if (finished)
+                {
+                    return false;
+                }
+                finished = true;
+                wheel->ClearTimeout(timeout);
+                input.reset();
+                return true;
+            }
+        };
+        auto result = std::make_shared<Result>();
+        result->input = promise;
+        result->wheel = &Detail::CurrentTimerWheel();
+        result->timeout = result->wheel->SetTimeout([result]()
+                                                    {
+            if (result->finished)
+            {
+                return;
+            }
+            result->finished = true;
+            auto input = std::exchange(result->input, std::nullopt);
+            input->Cancel();
+            result->promise.Reject(std::make_exception_ptr(TimeoutError("Timed out"))); },
+                                                    ms);
+        /** The timer or the input's callbacks hold result until it settles */
+        Detail::OnCancel(result->promise, [](void *context)
+                         {
+            auto result = static_cast<Result *>(context);
+            if (result->finished)
+            {
+                return;
+            }
+            /** Finished first, so the input's CancelledError is ignored. The result rejects itself with its own. */
+            auto input = std::exchange(result->input, std::nullopt);
+            result->Finish();
+            input->Cancel(); },
+                         result.get());
+        if constexpr (std::is_void_v<T>)
+        {
+            promise.Then([result]()
+                         {
+                if (result->Finish())
+                {
+                    result->promise.Resolve();
+                } });
+        }
+        else
+        {
+            promise.Then([result](T value)
+                         {
+                if (result->Finish())
+                {
+                    result->promise.Resolve(std::move(value));
+                } });
+        }
+        promise.Catch([result](const std::exception_ptr &e)
+                      {
+            if (result->Finish())
+            {
+                result->promise.Reject(e);
+            } });
+        return result->promise;
+    }
+
+} // namespace JS
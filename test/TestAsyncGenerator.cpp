@@ -1,6 +1,9 @@
 #include <vector>
 #include <memory>
+#include <span>
+#include <string>
 #include <iostream>
+#include <utility>
 #include <tev-cpp/Tev.h>
 #include "../include/AsyncGenerator.h"
 #include "TestUtility.h"
@@ -60,6 +63,36 @@ JS::AsyncGenerator<int> GenExceptionAsync(const std::string reason)
     throw std::runtime_error(reason);
 }
 
+JS::AsyncGenerator<int, int, 4> GenInlineAsync(int count, int &produced)
+{
+    for (int i = 0; i < count; i++)
+    {
+        produced++;
+        co_yield i;
+    }
+    co_return count;
+}
+
+JS::AsyncGenerator<int, void, 4> GenInlineBoundedAsync(JS::GeneratorCapacity capacity, int count)
+{
+    (void)capacity;
+    for (int i = 0; i < count; i++)
+    {
+        co_yield i;
+    }
+}
+
+JS::AsyncGenerator<int, int> GenBoundedAsync(JS::GeneratorCapacity capacity, int count, int &produced)
+{
+    (void)capacity;
+    for (int i = 0; i < count; i++)
+    {
+        produced++;
+        co_yield i;
+    }
+    co_return count;
+}
+
 JS::Promise<void> TestGenNumbersAsync()
 {
     size_t start = 1;
@@ -174,6 +207,260 @@ JS::Promise<void> TestGenExceptionAsync()
     }
 }
 
+JS::Promise<void> TestBoundedAsync()
+{
+    int produced = 0;
+    auto gen = GenBoundedAsync(JS::GeneratorCapacity{2}, 10, produced);
+    /** Nothing is consumed yet, the producer stops once the buffer is full */
+    assert(produced == 2, "Producer did not stop at capacity");
+    co_await DelayAsync(10);
+    assert(produced == 2, "Producer resumed without a consumer");
+    int consumed = 0;
+    while (true)
+    {
+        auto next = co_await gen.NextAsync();
+        if (!next.has_value())
+        {
+            break;
+        }
+        assert(next.value() == consumed, "Generator yielded unexpected value");
+        consumed++;
+        assert(produced - consumed <= 2, "Producer ran past capacity");
+        co_await DelayAsync(1);
+    }
+    assert(consumed == 10, "Generator did not yield the expected number of values");
+    assert(gen.GetReturnValue() == 10, "Generator did not return the expected value");
+
+    try
+    {
+        JS::GeneratorCapacity zero{0};
+        assert(false, "Zero capacity should throw");
+    }
+    catch (const std::invalid_argument &)
+    {
+    }
+}
+
+JS::Promise<void> TestInlineCapacityAsync()
+{
+    int produced = 0;
+    auto gen = GenInlineAsync(10, produced);
+    /** The inline buffer bounds the producer without a GeneratorCapacity */
+    assert(produced == 4, "Producer did not stop at the inline capacity");
+    int consumed = 0;
+    while (auto next = co_await gen.NextAsync())
+    {
+        assert(next.value() == consumed, "Generator yielded unexpected value");
+        consumed++;
+        assert(produced - consumed <= 4, "Producer ran past the inline capacity");
+    }
+    assert(consumed == 10, "Generator did not yield the expected number of values");
+    assert(gen.GetReturnValue() == 10, "Generator did not return the expected value");
+
+    auto lower = GenInlineBoundedAsync(JS::GeneratorCapacity{2}, 3);
+    std::vector<int> values{};
+    while (auto next = co_await lower.NextAsync())
+    {
+        values.push_back(*next);
+    }
+    assert((values == std::vector<int>{0, 1, 2}), "Lower capacity changed the values");
+    try
+    {
+        GenInlineBoundedAsync(JS::GeneratorCapacity{8}, 3);
+        assert(false, "Capacity above the inline buffer should throw");
+    }
+    catch (const std::invalid_argument &)
+    {
+    }
+
+    JS::AsyncGenerator<int, void, 2> fed{};
+    fed.Feed(1);
+    fed.Feed(2);
+    try
+    {
+        fed.Feed(3);
+        assert(false, "Feeding a full inline buffer should throw");
+    }
+    catch (const std::length_error &)
+    {
+    }
+    assert((co_await fed.NextAsync()).value() == 1, "Fed value lost");
+    fed.Finish();
+}
+
+JS::Promise<void> TestAsPromiseAsync()
+{
+    JS::AsyncGenerator<int> gen{};
+    gen.Feed(1);
+    auto ready = gen.NextAsync().AsPromise();
+    assert((co_await ready).value() == 1, "Buffered value not resolved");
+
+    /** Waiting as a promise, then fed */
+    auto waiting = gen.NextAsync().AsPromise();
+    tev.SetTimeout([=]()
+                   { gen.Feed(2); }, 10);
+    std::vector<JS::Promise<std::optional<int>>> promises{};
+    promises.push_back(waiting);
+    promises.push_back(JS::Promise<std::optional<int>>{});
+    auto raced = co_await JS::Promise<std::optional<int>>::Race(promises);
+    assert(raced.value() == 2, "Fed value not resolved");
+
+    gen.Finish();
+    auto end = co_await gen.NextAsync().AsPromise();
+    assert(!end.has_value(), "Finished generator should resolve empty");
+}
+
+static JS::AsyncGenerator<int> DelayedValueAsync(int value, int ms)
+{
+    co_await DelayAsync(ms);
+    co_yield value;
+}
+
+JS::Promise<void> TestAsPromiseOutlivesGeneratorAsync()
+{
+    JS::Promise<std::optional<int>> pending{};
+    {
+        auto gen = DelayedValueAsync(5, 10);
+        pending = gen.NextAsync().AsPromise();
+    }
+    /** The generator is gone while the read waits */
+    auto value = co_await pending;
+    assert(value.value() == 5, "Pending read lost its value");
+}
+
+static JS::Promise<void> WorkerAsync(JS::AsyncGenerator<int> gen, int id, std::vector<std::pair<int, int>> &handled)
+{
+    while (auto value = co_await gen.NextAsync())
+    {
+        handled.emplace_back(id, *value);
+        co_await DelayAsync(10 * (id + 1));
+    }
+}
+
+JS::Promise<void> TestPipelinedNextAsync()
+{
+    JS::AsyncGenerator<int> gen{};
+    std::vector<std::pair<int, int>> handled{};
+    std::vector<JS::Promise<void>> workers{};
+    for (int id = 0; id < 3; id++)
+    {
+        workers.push_back(WorkerAsync(gen, id, handled));
+    }
+    /** Reads are served in the order they started waiting */
+    auto promised = gen.NextAsync().AsPromise();
+    for (int i = 0; i < 4; i++)
+    {
+        gen.Feed(i);
+    }
+    assert(handled.size() == 3, "Waiting workers did not get the first values");
+    for (int id = 0; id < 3; id++)
+    {
+        assert(handled[id] == std::make_pair(id, id), "Values were not handed out in order");
+    }
+    assert((co_await promised).value() == 3, "Promised read did not get its value");
+    for (int i = 4; i < 10; i++)
+    {
+        gen.Feed(i);
+    }
+    co_await DelayAsync(5);
+    gen.Finish();
+    co_await JS::Promise<void>::All(workers);
+    /** All but the one the promise took, still taken from the buffer in order */
+    assert(handled.size() == 9, "Values were lost");
+    for (size_t i = 3; i < handled.size(); i++)
+    {
+        assert(handled[i].second == static_cast<int>(i) + 1, "Values were not handed out in order");
+    }
+}
+
+JS::Promise<void> TestRejectWithWaitersAsync()
+{
+    JS::AsyncGenerator<int> gen{};
+    auto first = gen.NextAsync().AsPromise();
+    auto second = gen.NextAsync().AsPromise();
+    gen.Reject("Failed");
+    try
+    {
+        co_await first;
+        assert(false, "First waiter should get the exception");
+    }
+    catch (const std::runtime_error &e)
+    {
+        assert(std::string(e.what()) == "Failed", "Wrong exception");
+    }
+    assert(!(co_await second).has_value(), "Later waiters should see the end");
+}
+
+JS::AsyncGenerator<int> GenBatchesAsync(int batches, int size)
+{
+    int next = 0;
+    for (int b = 0; b < batches; b++)
+    {
+        std::vector<int> batch{};
+        for (int i = 0; i < size; i++)
+        {
+            batch.push_back(next++);
+        }
+        co_yield JS::Batch(std::move(batch));
+        co_await DelayAsync(10);
+    }
+    co_yield next;
+}
+
+JS::Promise<void> TestBatchAsync()
+{
+    /** The first batch is buffered, the later ones are fed while the consumer waits */
+    auto gen = GenBatchesAsync(3, 10);
+    std::vector<int> batch{};
+    std::vector<size_t> counts{};
+    int expected = 0;
+    while (size_t count = co_await gen.NextBatchAsync(batch, 4))
+    {
+        assert(count == batch.size(), "Count does not match the batch");
+        for (int value : batch)
+        {
+            assert(value == expected++, "Batch values out of order");
+        }
+        counts.push_back(count);
+    }
+    assert(expected == 31, "Values were lost");
+    assert((counts == std::vector<size_t>{4, 4, 2, 4, 4, 2, 4, 4, 2, 1}), "Batches were not filled from the buffer");
+
+    JS::AsyncGenerator<std::unique_ptr<int>> pointers{};
+    std::vector<std::unique_ptr<int>> fed{};
+    fed.push_back(std::make_unique<int>(1));
+    fed.push_back(std::make_unique<int>(2));
+    pointers.Feed(std::move(fed[0]));
+    pointers.Feed(std::move(fed[1]));
+    pointers.Finish();
+    std::unique_ptr<int> slots[3]{};
+    size_t taken = co_await pointers.NextBatchAsync(std::span<std::unique_ptr<int>>{slots});
+    assert(taken == 2 && *slots[0] == 1 && *slots[1] == 2, "Span batch mismatch");
+    assert(co_await pointers.NextBatchAsync(std::span<std::unique_ptr<int>>{slots}) == 0, "Finished generator should give 0");
+}
+
+JS::AsyncGenerator<std::string> GenWordsAsync(std::vector<std::string> &words)
+{
+    /** An rvalue span still refers to the caller's strings */
+    co_yield JS::Batch(std::span<std::string>{words});
+    std::vector<std::string> owned{};
+    owned.push_back("owned");
+    co_yield JS::Batch(std::move(owned));
+}
+
+JS::Promise<void> TestBatchSpanCopiesAsync()
+{
+    std::vector<std::string> words{};
+    words.push_back("a fairly long string, not stored inline");
+    words.push_back("another fairly long string, not stored inline");
+    auto gen = GenWordsAsync(words);
+    std::vector<std::string> batch{};
+    size_t count = co_await gen.NextBatchAsync(batch, 8);
+    assert(count == 3 && batch[0] == words[0] && batch[1] == words[1] && batch[2] == "owned", "Batch values mismatch");
+    assert(words[0] == "a fairly long string, not stored inline" && words[1] == "another fairly long string, not stored inline",
+           "Elements moved out of a span");
+}
+
 JS::Promise<void> TestAsync()
 {
     RunAsyncTest(TestGenNumbersAsync);
@@ -181,6 +468,14 @@ JS::Promise<void> TestAsync()
     RunAsyncTest(TestGenNumbersNonCopyableAsync);
     RunAsyncTest(TestGenNumbersNonCopyableWithReturnAsync);
     RunAsyncTest(TestGenExceptionAsync);
+    RunAsyncTest(TestBoundedAsync);
+    RunAsyncTest(TestInlineCapacityAsync);
+    RunAsyncTest(TestAsPromiseAsync);
+    RunAsyncTest(TestAsPromiseOutlivesGeneratorAsync);
+    RunAsyncTest(TestPipelinedNextAsync);
+    RunAsyncTest(TestRejectWithWaitersAsync);
+    RunAsyncTest(TestBatchAsync);
+    RunAsyncTest(TestBatchSpanCopiesAsync);
 }
 
 int main(int argc, char const *argv[])
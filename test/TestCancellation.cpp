@@ -0,0 +1,289 @@
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../include/Cancellation.h"
+#include "../include/EventLoop.h"
+#include "../include/Promise.h"
+#include "../include/TimerWheel.h"
+#include "TestUtility.h"
+
+template <typename T>
+static bool IsCancelled(const JS::Promise<T> &promise)
+{
+    bool cancelled = false;
+    promise.Catch([&](const std::exception_ptr &e)
+                  {
+        try
+        {
+            std::rethrow_exception(e);
+        }
+        catch (const JS::CancelledError &)
+        {
+            cancelled = true;
+        }
+        catch (...)
+        {
+        } });
+    return cancelled;
+}
+
+static void TestRegistration()
+{
+    JS::CancellationSource source{};
+    auto token = source.Token();
+    std::vector<int> order{};
+    JS::CancellationRegistration first{token, [&]()
+                                       { order.push_back(1); }};
+    JS::CancellationRegistration dropped{token, [&]()
+                                         { order.push_back(0); }};
+    JS::CancellationRegistration second{};
+    second.Register(token, [&]()
+                    { order.push_back(2); });
+    dropped.Unregister();
+    {
+        JS::CancellationRegistration scoped{token, [&]()
+                                            { order.push_back(0); }};
+    }
+    assert(!token.IsCancelled(), "cancelled early");
+    source.Cancel();
+    source.Cancel();
+    assert(token.IsCancelled() && source.IsCancelled(), "not cancelled");
+    assert((order == std::vector<int>{1, 2}), "wrong callbacks");
+
+    /** Too late to wait, so it calls back right away */
+    JS::CancellationRegistration late{token, [&]()
+                                      { order.push_back(3); }};
+    assert(order.back() == 3, "late registration not called");
+
+    try
+    {
+        token.ThrowIfCancelled();
+        assert(false, "should have thrown");
+    }
+    catch (const JS::CancelledError &)
+    {
+    }
+    JS::CancellationToken none{};
+    assert(!none.CanBeCancelled() && !none.IsCancelled(), "default token should never cancel");
+}
+
+static void TestUnregisterWhileCancelling()
+{
+    JS::CancellationSource source{};
+    int count = 0;
+    auto *second = new JS::CancellationRegistration{};
+    JS::CancellationRegistration first{source.Token(), [&]()
+                                       {
+        count++;
+        delete second;
+        second = nullptr; }};
+    second->Register(source.Token(), [&]()
+                     { count += 10; });
+    source.Cancel();
+    assert(count == 1 && second == nullptr, "unregistered callback ran");
+}
+
+static void TestPromiseCancel()
+{
+    JS::Promise<int> promise{};
+    bool notified = false;
+    JS::CancellationRegistration registration{promise.Token(), [&]()
+                                              { notified = true; }};
+    promise.Cancel();
+    assert(notified, "token not cancelled");
+    assert(IsCancelled(promise), "should reject with CancelledError");
+    /** Whoever was going to resolve it finds it settled */
+    promise.Resolve(1);
+    promise.Cancel();
+
+    JS::Promise<void> resolved{};
+    resolved.Resolve();
+    resolved.Cancel();
+    assert(!resolved.Token().IsCancelled(), "settled promise cancelled");
+}
+
+static JS::EventLoop loop{};
+
+static JS::Promise<int> LeafAsync(JS::Promise<int> &leaf)
+{
+    co_return co_await leaf + 1;
+}
+
+static JS::Promise<int> ChainAsync(JS::Promise<int> &leaf, bool &reached)
+{
+    int value = co_await LeafAsync(leaf);
+    reached = true;
+    co_return value;
+}
+
+JS::Promise<void> TestChainAsync()
+{
+    JS::Promise<int> leaf{};
+    bool reached = false;
+    auto chain = ChainAsync(leaf, reached);
+    co_await JS::Delay(1);
+    chain.Cancel();
+    co_await JS::Delay(1);
+    assert(leaf.Token().IsCancelled(), "cancel did not reach the leaf");
+    assert(IsCancelled(chain) && !reached, "chain kept running");
+}
+
+static JS::Promise<int> SlowAsync(int ms, int value, bool &cancelled)
+{
+    auto token = co_await JS::CurrentCancellationToken();
+    JS::CancellationRegistration registration{token, [&]()
+                                              { cancelled = true; }};
+    co_await JS::Delay(ms);
+    co_return value;
+}
+
+static JS::Promise<void> SlowVoidAsync(bool &cancelled)
+{
+    co_await SlowAsync(1000, 0, cancelled);
+}
+
+JS::Promise<void> TestRaceCancelsLosersAsync()
+{
+    bool fast = false;
+    bool slow = false;
+    std::vector<JS::Promise<int>> promises{};
+    promises.push_back(SlowAsync(10, 1, fast));
+    promises.push_back(SlowAsync(1000, 2, slow));
+    int value = co_await JS::Promise<int>::Race(promises);
+    assert(value == 1, "wrong winner");
+    assert(!fast && slow, "loser not cancelled");
+}
+
+JS::Promise<void> TestAnyCancelsLosersAsync()
+{
+    bool first = false;
+    bool second = false;
+    bool third = false;
+    std::vector<JS::Promise<int>> promises{};
+    promises.push_back(SlowAsync(1000, 1, first));
+    promises.push_back(SlowAsync(10, 2, second));
+    promises.push_back(SlowAsync(1000, 3, third));
+    int value = co_await JS::Promise<int>::Any(promises);
+    assert(value == 2, "wrong winner");
+    assert(first && !second && third, "losers not cancelled");
+
+    /** Decided while registering, the rest are cancelled right away */
+    JS::Promise<void> done{};
+    done.Resolve();
+    bool late = false;
+    std::vector<JS::Promise<void>> voids{};
+    voids.push_back(done);
+    voids.push_back(SlowVoidAsync(late));
+    co_await JS::Promise<void>::Any(voids);
+    assert(late, "late loser not cancelled");
+}
+
+JS::Promise<void> TestCancelRaceAsync()
+{
+    bool first = false;
+    bool second = false;
+    std::vector<JS::Promise<int>> promises{};
+    promises.push_back(SlowAsync(1000, 1, first));
+    promises.push_back(SlowAsync(1000, 2, second));
+    auto race = JS::Promise<int>::Race(promises);
+    race.Cancel();
+    assert(first && second, "inputs not cancelled");
+    assert(IsCancelled(race), "race should reject with CancelledError");
+    co_return;
+}
+
+JS::Promise<void> TestWithTimeoutCancelsAsync()
+{
+    bool cancelled = false;
+    try
+    {
+        co_await JS::WithTimeout(SlowAsync(1000, 0, cancelled), 10);
+        assert(false, "should have timed out");
+    }
+    catch (const JS::TimeoutError &)
+    {
+    }
+    assert(cancelled, "timed out work not cancelled");
+}
+
+JS::Promise<void> TestCancelWithTimeoutAsync()
+{
+    size_t pending = loop.Timers().Size();
+    bool cancelled = false;
+    auto timed = JS::WithTimeout(SlowAsync(1000, 0, cancelled), 5000);
+    timed.Cancel();
+    assert(cancelled, "input not cancelled");
+    assert(IsCancelled(timed), "should reject with CancelledError");
+    assert(loop.Timers().Size() == pending, "timers left pending");
+    co_return;
+}
+
+JS::Promise<void> TestCancelDelayClearsTimerAsync()
+{
+    size_t pending = loop.Timers().Size();
+    std::vector<JS::Promise<void>> promises{};
+    promises.push_back(JS::Delay(5));
+    promises.push_back(JS::Delay(5000));
+    promises.push_back(loop.Delay(5000));
+    co_await JS::Promise<void>::Race(promises);
+    assert(loop.Timers().Size() == pending, "losers' timers left pending");
+
+    auto delay = JS::Delay(5000);
+    delay.Cancel();
+    assert(IsCancelled(delay), "should reject with CancelledError");
+    assert(loop.Timers().Size() == pending, "timer left pending");
+}
+
+static JS::Promise<int> CountUntilCancelledAsync(int &count)
+{
+    auto token = co_await JS::CurrentCancellationToken();
+    while (true)
+    {
+        /** The delay may have settled in the same tick the cancel came in, so check again */
+        token.ThrowIfCancelled();
+        count++;
+        co_await JS::Delay(1);
+    }
+    co_return count;
+}
+
+JS::Promise<void> TestCurrentTokenAsync()
+{
+    int count = 0;
+    auto counting = CountUntilCancelledAsync(count);
+    co_await JS::Delay(20);
+    counting.Cancel();
+    int stopped = count;
+    co_await JS::Delay(20);
+    assert(count == stopped, "kept counting after cancel");
+    assert(IsCancelled(counting), "should reject with CancelledError");
+}
+
+JS::Promise<void> TestAsync()
+{
+    RunAsyncTest(TestChainAsync);
+    RunAsyncTest(TestRaceCancelsLosersAsync);
+    RunAsyncTest(TestAnyCancelsLosersAsync);
+    RunAsyncTest(TestCancelRaceAsync);
+    RunAsyncTest(TestWithTimeoutCancelsAsync);
+    RunAsyncTest(TestCancelWithTimeoutAsync);
+    RunAsyncTest(TestCancelDelayClearsTimerAsync);
+    RunAsyncTest(TestCurrentTokenAsync);
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    TestRegistration();
+    TestUnregisterWhileCancelling();
+    TestPromiseCancel();
+
+    JS::ScopedTimerWheel timers{loop.Timers()};
+    loop.RunUntilComplete(TestAsync());
+
+    std::cout << "Cancellation tests completed successfully." << std::endl;
+    return 0;
+}
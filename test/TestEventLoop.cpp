@@ -0,0 +1,122 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/EventLoop.h"
+#include "../include/ThreadSafePromise.h"
+#include "TestUtility.h"
+
+static JS::EventLoop loop{};
+
+static JS::Promise<int> ReturnAfterDelayAsync(int ms, int value)
+{
+    co_await loop.Delay(ms);
+    co_return value;
+}
+
+static JS::Promise<int> ThrowAfterDelayAsync(int ms, const std::string reason)
+{
+    co_await loop.Delay(ms);
+    throw std::runtime_error(reason);
+}
+
+JS::Promise<void> TestDelayAsync()
+{
+    auto start = std::chrono::steady_clock::now();
+    co_await loop.Delay(100);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    assert(elapsed >= std::chrono::milliseconds(100), "resumed too early");
+    int value = co_await ReturnAfterDelayAsync(50, 42);
+    assert(value == 42, "wrong value");
+}
+
+JS::Promise<void> TestTimerOrderAsync()
+{
+    std::vector<int> order{};
+    loop.SetTimeout([&]()
+                    { order.push_back(3); },
+                    30);
+    loop.SetTimeout([&]()
+                    { order.push_back(1); },
+                    10);
+    loop.SetTimeout([&]()
+                    { order.push_back(2); },
+                    10);
+    auto cleared = loop.SetTimeout([&]()
+                                   { order.push_back(0); },
+                                   20);
+    loop.ClearTimeout(cleared);
+    /** Clearing twice, or a stale handle, is harmless */
+    loop.ClearTimeout(cleared);
+    co_await loop.Delay(50);
+    assert((order == std::vector<int>{1, 2, 3}), "timers fired out of order");
+}
+
+JS::Promise<void> TestConcurrentDelaysAsync()
+{
+    auto promises = std::vector<JS::Promise<int>>{};
+    for (int i = 0; i < 100; i++)
+    {
+        promises.push_back(ReturnAfterDelayAsync(100 - i, i));
+    }
+    auto values = co_await JS::Promise<int>::All(promises);
+    for (int i = 0; i < 100; i++)
+    {
+        assert(values[i] == i, "wrong value");
+    }
+}
+
+JS::Promise<void> TestRemotePostAsync()
+{
+    /** A worker thread resolves, the loop sleeps until then */
+    JS::ThreadSafePromise<int> promise{};
+    auto loopThread = std::this_thread::get_id();
+    std::thread worker{[=]()
+                       {
+                           std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                           promise.Resolve(42);
+                       }};
+    int value = co_await promise;
+    worker.join();
+    assert(value == 42, "wrong value");
+    assert(std::this_thread::get_id() == loopThread, "resumed off the loop thread");
+}
+
+JS::Promise<void> TestAsync()
+{
+    RunAsyncTest(TestDelayAsync);
+    RunAsyncTest(TestTimerOrderAsync);
+    RunAsyncTest(TestConcurrentDelaysAsync);
+    RunAsyncTest(TestRemotePostAsync);
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    loop.RunUntilComplete(TestAsync());
+
+    int value = loop.RunUntilComplete(ReturnAfterDelayAsync(10, 7));
+    assert(value == 7, "RunUntilComplete wrong value");
+    try
+    {
+        loop.RunUntilComplete(ThrowAfterDelayAsync(10, "Delayed throw"));
+        assert(false, "RunUntilComplete should have thrown");
+    }
+    catch (const std::exception &e)
+    {
+        assert(std::string(e.what()) == "Delayed throw", "RunUntilComplete wrong reason");
+    }
+
+    /** Run returns once nothing is left */
+    bool fired = false;
+    loop.SetTimeout([&]()
+                    { fired = true; },
+                    10);
+    loop.Run();
+    assert(fired, "Run returned before the timer fired");
+
+    return 0;
+}
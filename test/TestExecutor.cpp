@@ -0,0 +1,131 @@
+#include <iostream>
+#include <optional>
+#include <vector>
+#include "../include/AsyncGenerator.h"
+#include "../include/Executor.h"
+#include "../include/Promise.h"
+#include "TestUtility.h"
+
+static JS::Promise<void> AwaitAndCountAsync(JS::Promise<int> promise, int &count)
+{
+    count += co_await promise;
+}
+
+static JS::Promise<int> ForwardAsync(JS::Promise<int> promise)
+{
+    co_return co_await promise;
+}
+
+static JS::Promise<void> AwaitAndLogAsync(JS::Promise<int> promise, std::vector<int> &log)
+{
+    log.push_back(co_await promise);
+}
+
+static JS::Promise<void> ConsumeAsync(JS::AsyncGenerator<int> generator, std::vector<int> &seen)
+{
+    while (auto value = co_await generator.NextAsync())
+    {
+        seen.push_back(*value);
+    }
+}
+
+static void TestInlineByDefault()
+{
+    JS::Promise<int> promise{};
+    int count = 0;
+    auto awaiter = AwaitAndCountAsync(promise, count);
+    promise.Resolve(1);
+    assert(count == 1, "should resume inline without an executor");
+
+    JS::InlineExecutor executor{};
+    JS::ScopedExecutor scope{executor};
+    JS::Promise<int> another{};
+    auto inlineAwaiter = AwaitAndCountAsync(another, count);
+    another.Resolve(1);
+    assert(count == 2, "InlineExecutor should resume inline");
+}
+
+static void TestQueuedResume()
+{
+    JS::QueueExecutor executor{};
+    JS::ScopedExecutor scope{executor};
+    JS::Promise<int> promise{};
+    int count = 0;
+    auto awaiter = AwaitAndCountAsync(promise, count);
+    promise.Resolve(1);
+    assert(count == 0, "should not resume on the resolving call stack");
+    assert(!executor.Empty(), "resumption should be queued");
+    assert(executor.Drain() == 1, "should drain one");
+    assert(count == 1, "should resume when drained");
+    assert(executor.Empty(), "queue should be empty");
+}
+
+static void TestDrainIsBounded()
+{
+    JS::QueueExecutor executor{};
+    JS::ScopedExecutor scope{executor};
+    std::vector<JS::Promise<int>> promises(10);
+    std::vector<JS::Promise<void>> awaiters{};
+    int count = 0;
+    for (auto &promise : promises)
+    {
+        awaiters.push_back(AwaitAndCountAsync(promise, count));
+    }
+    for (auto &promise : promises)
+    {
+        promise.Resolve(1);
+    }
+    assert(executor.Drain(4) == 4 && count == 4, "first drain should stop at 4");
+    assert(executor.Drain(4) == 4 && count == 8, "second drain should stop at 4");
+    assert(executor.Drain(4) == 2 && count == 10, "third drain should finish");
+}
+
+static void TestReturnThroughExecutor()
+{
+    JS::QueueExecutor executor{};
+    JS::ScopedExecutor scope{executor};
+    JS::Promise<int> first{};
+    JS::Promise<int> second{};
+    std::vector<int> log{};
+    auto outer = AwaitAndLogAsync(ForwardAsync(first), log);
+    auto other = AwaitAndLogAsync(second, log);
+    first.Resolve(1);
+    second.Resolve(2);
+    assert(executor.Drain() == 2, "should drain the two resolved awaiters");
+    /** ForwardAsync returned during that drain, its awaiter was queued behind it */
+    assert((log == std::vector<int>{2}), "co_return should not resume its awaiter inline");
+    assert(executor.Drain() == 1, "the awaiter of the returned coroutine should be queued");
+    assert((log == std::vector<int>{2, 1}), "wrong order across co_return");
+}
+
+static void TestGeneratorThroughExecutor()
+{
+    JS::QueueExecutor executor{};
+    JS::ScopedExecutor scope{executor};
+    JS::AsyncGenerator<int> generator{};
+    std::vector<int> seen{};
+    auto consumer = ConsumeAsync(generator, seen);
+    generator.Feed(1);
+    assert(seen.empty(), "consumer should not run inside Feed");
+    executor.Drain();
+    generator.Feed(2);
+    generator.Finish();
+    executor.Drain();
+    assert((seen == std::vector<int>{1, 2}), "wrong values");
+    assert(consumer.await_ready(), "consumer should have finished");
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    TestInlineByDefault();
+    TestQueuedResume();
+    TestDrainIsBounded();
+    TestReturnThroughExecutor();
+    TestGeneratorThroughExecutor();
+
+    std::cout << "Executor tests completed successfully." << std::endl;
+    return 0;
+}
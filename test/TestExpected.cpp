@@ -0,0 +1,185 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../include/Expected.h"
+#include "TestUtility.h"
+
+enum class Error
+{
+    Timeout,
+    Refused,
+};
+
+static JS::Promise<JS::Expected<int, Error>> QueryAsync(JS::Promise<void> ready, int value)
+{
+    co_await ready;
+    if (value < 0)
+    {
+        co_return JS::Unexpected{Error::Refused};
+    }
+    co_return value;
+}
+
+static JS::Promise<JS::Expected<int, Error>> SumAsync(JS::Promise<void> ready, int a, int b)
+{
+    auto first = co_await QueryAsync(ready, a);
+    if (!first)
+    {
+        co_return JS::Unexpected{first.Error()};
+    }
+    auto second = co_await QueryAsync(ready, b);
+    if (!second)
+    {
+        co_return JS::Unexpected{second.Error()};
+    }
+    co_return first.Value() + second.Value();
+}
+
+JS::Promise<void> TestExpectedAwaitAsync()
+{
+    JS::Promise<void> okReady{};
+    JS::Promise<void> failedReady{};
+    auto ok = SumAsync(okReady, 1, 2);
+    auto failed = SumAsync(failedReady, 1, -2);
+    okReady.Resolve();
+    failedReady.Resolve();
+    auto sum = co_await ok;
+    assert(sum.HasValue() && sum.Value() == 3, "wrong sum");
+    auto error = co_await failed;
+    assert(!error && error.Error() == Error::Refused, "error should be delivered as a value");
+}
+
+JS::Promise<void> TestAllExpectedAsync()
+{
+    auto promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(3);
+    auto all = JS::AllExpected(promises);
+    promises[2].Resolve(3);
+    promises[0].Resolve(1);
+    promises[1].Resolve(2);
+    auto values = co_await all;
+    assert(values && values.Value() == std::vector<int>({1, 2, 3}), "wrong values");
+
+    promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(3);
+    all = JS::AllExpected(promises);
+    promises[0].Resolve(1);
+    promises[1].Resolve(JS::Unexpected{Error::Timeout});
+    /** Short circuited, the last one does not matter */
+    auto failed = co_await all;
+    assert(!failed && failed.Error() == Error::Timeout, "should fail with the first error");
+    promises[2].Resolve(JS::Unexpected{Error::Refused});
+
+    auto voids = std::vector<JS::Promise<JS::Expected<void, std::string>>>(2);
+    auto allVoid = JS::AllExpected(voids);
+    voids[0].Resolve(JS::Expected<void, std::string>{});
+    voids[1].Resolve(JS::Unexpected{std::string("refused")});
+    auto voidResult = co_await allVoid;
+    assert(!voidResult && voidResult.Error() == "refused", "void error mismatch");
+}
+
+JS::Promise<void> TestAnyExpectedAsync()
+{
+    auto promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(3);
+    auto any = JS::AnyExpected(promises);
+    promises[0].Resolve(JS::Unexpected{Error::Timeout});
+    promises[1].Resolve(2);
+    promises[2].Resolve(3);
+    auto first = co_await any;
+    assert(first && first.Value() == 2, "should resolve with the first success");
+
+    promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(2);
+    any = JS::AnyExpected(promises);
+    promises[0].Resolve(JS::Unexpected{Error::Timeout});
+    promises[1].Resolve(JS::Unexpected{Error::Refused});
+    auto failed = co_await any;
+    assert(!failed && failed.Error() == Error::Refused, "should fail with the last error");
+}
+
+JS::Promise<void> TestExpectedExceptionAsync()
+{
+    /** Exceptions still travel on the rejection path */
+    auto promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(2);
+    auto all = JS::AllExpected(promises);
+    promises[0].Reject("broken");
+    try
+    {
+        co_await all;
+        assert(false, "should have thrown");
+    }
+    catch (const std::exception &e)
+    {
+        assert(std::string(e.what()) == "broken", "wrong reason");
+    }
+    promises[1].Resolve(1);
+}
+
+JS::Promise<void> TestAllExpectedCancelsAsync()
+{
+    auto promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(3);
+    auto all = JS::AllExpected(promises);
+    promises[1].Resolve(JS::Unexpected{Error::Timeout});
+    auto failed = co_await all;
+    assert(!failed && failed.Error() == Error::Timeout, "should fail with the first error");
+    assert(promises[0].Token().IsCancelled() && promises[2].Token().IsCancelled(), "remaining inputs not cancelled");
+
+    promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(2);
+    all = JS::AllExpected(promises);
+    promises[0].Reject("broken");
+    assert(promises[1].Token().IsCancelled(), "remaining input not cancelled on rejection");
+
+    promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(2);
+    all = JS::AllExpected(promises);
+    all.Cancel();
+    assert(promises[0].Token().IsCancelled() && promises[1].Token().IsCancelled(), "inputs not cancelled");
+}
+
+JS::Promise<void> TestAnyExpectedExceptionAsync()
+{
+    /** A rejection is one more failure, a later success still wins */
+    auto promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(4);
+    auto any = JS::AnyExpected(promises);
+    promises[0].Reject("broken");
+    promises[1].Resolve(JS::Unexpected{Error::Timeout});
+    promises[2].Resolve(5);
+    auto first = co_await any;
+    assert(first && first.Value() == 5, "should resolve with the first success");
+    assert(promises[3].Token().IsCancelled(), "loser not cancelled");
+
+    promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(2);
+    any = JS::AnyExpected(promises);
+    promises[0].Resolve(JS::Unexpected{Error::Timeout});
+    promises[1].Reject("broken");
+    try
+    {
+        co_await any;
+        assert(false, "should have thrown");
+    }
+    catch (const std::exception &e)
+    {
+        assert(std::string(e.what()) == "broken", "should reject with the last failure");
+    }
+
+    promises = std::vector<JS::Promise<JS::Expected<int, Error>>>(2);
+    any = JS::AnyExpected(promises);
+    any.Cancel();
+    assert(promises[0].Token().IsCancelled() && promises[1].Token().IsCancelled(), "inputs not cancelled");
+}
+
+JS::Promise<void> TestAsync()
+{
+    RunAsyncTest(TestExpectedAwaitAsync);
+    RunAsyncTest(TestAllExpectedAsync);
+    RunAsyncTest(TestAnyExpectedAsync);
+    RunAsyncTest(TestExpectedExceptionAsync);
+    RunAsyncTest(TestAllExpectedCancelsAsync);
+    RunAsyncTest(TestAnyExpectedExceptionAsync);
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    TestAsync();
+
+    return 0;
+}
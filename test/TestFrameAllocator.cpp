@@ -0,0 +1,166 @@
+#include <iostream>
+#include <thread>
+#include "../include/AsyncGenerator.h"
+#include "TestUtility.h"
+
+struct CountingAllocator : JS::FrameAllocator
+{
+    size_t allocated = 0;
+    size_t deallocated = 0;
+
+    void *Allocate(size_t size) override
+    {
+        allocated++;
+        return ::operator new(size);
+    }
+
+    void Deallocate(void *ptr, size_t size) override
+    {
+        deallocated++;
+        ::operator delete(ptr, size);
+    }
+};
+
+static JS::Promise<int> ReturnAsync(int value)
+{
+    co_return value;
+}
+
+static JS::Promise<int> ReturnWithAllocatorAsync(std::allocator_arg_t, JS::FrameAllocator &, int value)
+{
+    co_return value;
+}
+
+static JS::AsyncGenerator<int> GenNumbersWithAllocatorAsync(std::allocator_arg_t, JS::FrameAllocator &, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        co_yield i;
+    }
+}
+
+struct Worker
+{
+    int base = 40;
+    JS::Promise<int> AddAsync(std::allocator_arg_t, JS::FrameAllocator &, int value)
+    {
+        co_return base + value;
+    }
+};
+
+JS::Promise<void> TestExplicitAllocatorAsync()
+{
+    CountingAllocator allocator{};
+    {
+        int value = co_await ReturnWithAllocatorAsync(std::allocator_arg, allocator, 42);
+        assert(value == 42, "wrong result");
+    }
+    assert(allocator.allocated == 1, "frame not allocated from the explicit allocator");
+    assert(allocator.deallocated == 1, "frame not returned to the explicit allocator");
+}
+
+JS::Promise<void> TestMemberFunctionAllocatorAsync()
+{
+    CountingAllocator allocator{};
+    Worker worker{};
+    {
+        int value = co_await worker.AddAsync(std::allocator_arg, allocator, 2);
+        assert(value == 42, "wrong result");
+    }
+    assert(allocator.allocated == 1, "frame not allocated from the explicit allocator");
+    assert(allocator.deallocated == 1, "frame not returned to the explicit allocator");
+}
+
+JS::Promise<void> TestGeneratorAllocatorAsync()
+{
+    CountingAllocator allocator{};
+    {
+        auto gen = GenNumbersWithAllocatorAsync(std::allocator_arg, allocator, 3);
+        int count = 0;
+        while (auto next = co_await gen.NextAsync())
+        {
+            assert(next.value() == count, "wrong value");
+            count++;
+        }
+        assert(count == 3, "wrong count");
+    }
+    assert(allocator.allocated == 1, "frame not allocated from the explicit allocator");
+    assert(allocator.deallocated == 1, "frame not returned to the explicit allocator");
+}
+
+JS::Promise<void> TestScopedAllocatorAsync()
+{
+    CountingAllocator allocator{};
+    {
+        JS::ScopedFrameAllocator scope{allocator};
+        auto promise = ReturnAsync(42);
+        assert(JS::FrameAllocator::Current() == &allocator, "allocator not installed");
+        int value = co_await promise;
+        assert(value == 42, "wrong result");
+    }
+    assert(JS::FrameAllocator::Current() == nullptr, "allocator not restored");
+    assert(allocator.allocated == 1, "frame not allocated from the scoped allocator");
+    assert(allocator.deallocated == 1, "frame not returned to the scoped allocator");
+}
+
+JS::Promise<void> TestFramePoolReuseAsync()
+{
+    JS::FramePool pool{};
+    /** Sizes in the same class share a free list */
+    void *a = pool.Allocate(100);
+    pool.Deallocate(a, 100);
+    void *b = pool.Allocate(120);
+    assert(a == b, "block was not recycled");
+    pool.Deallocate(b, 120);
+    /** Frames of the same coroutine land in the same class */
+    JS::ScopedFrameAllocator scope{pool};
+    for (int i = 0; i < 3; i++)
+    {
+        int value = co_await ReturnAsync(i);
+        assert(value == i, "wrong result");
+    }
+    void *large = pool.Allocate(JS::FramePool::MaxPooledSize + 1);
+    pool.Deallocate(large, JS::FramePool::MaxPooledSize + 1);
+}
+
+JS::Promise<void> TestFramePoolForeignThreadAsync()
+{
+    JS::FramePool pool{};
+    void *a = pool.Allocate(100);
+    void *b = pool.Allocate(100);
+    pool.Deallocate(a, 100);
+    /** A frame finished on another worker goes back to the global allocator, not the free list */
+    std::thread other{[&]
+                      { pool.Deallocate(b, 100); }};
+    other.join();
+    void *c = pool.Allocate(100);
+    assert(c == a, "foreign deallocation reached the free list");
+    pool.Deallocate(c, 100);
+    void *d = nullptr;
+    std::thread allocating{[&]
+                           { d = pool.Allocate(100); }};
+    allocating.join();
+    assert(d != a, "foreign allocation took from the free list");
+    pool.Deallocate(d, 100);
+    co_return;
+}
+
+JS::Promise<void> TestAsync()
+{
+    RunAsyncTest(TestExplicitAllocatorAsync);
+    RunAsyncTest(TestMemberFunctionAllocatorAsync);
+    RunAsyncTest(TestGeneratorAllocatorAsync);
+    RunAsyncTest(TestScopedAllocatorAsync);
+    RunAsyncTest(TestFramePoolReuseAsync);
+    RunAsyncTest(TestFramePoolForeignThreadAsync);
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    TestAsync();
+
+    return 0;
+}
@@ -1,11 +1,39 @@
+#include <array>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <new>
+#include <ranges>
+#include <span>
 #include <tev-cpp/Tev.h>
 #include "../include/Promise.h"
 #include "TestUtility.h"
 
 static Tev tev{};
 
+static size_t allocationCount = 0;
+
+/** Not inlined, otherwise gcc pairs the inlined free() with operator new and warns */
+[[gnu::noinline]] void *operator new(size_t size)
+{
+    allocationCount++;
+    if (void *ptr = std::malloc(size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
 static JS::Promise<void> DelayAsync(int ms)
 {
     JS::Promise<void> promise{};
@@ -92,6 +120,20 @@ JS::Promise<void> TestThenAsync()
     co_await testPromise;
 }
 
+JS::Promise<void> TestThenMoveOnlyCaptureAsync()
+{
+    JS::Promise<void> testPromise{};
+    {
+        auto expected = std::make_unique<int>(42);
+        auto promise = ResolveAfterDelayAsync(100, 42);
+        promise.Then([=, expected = std::move(expected)](auto value){
+            assert(value == *expected, "wrong result");
+            testPromise.Resolve();
+        });
+    }
+    co_await testPromise;
+}
+
 static JS::Promise<int> RejectImmediatelyAsync(const std::string& reason)
 {
     JS::Promise<int> promise{};
@@ -225,6 +267,46 @@ JS::Promise<void> TestCoRoutineThenAsync()
     co_await testPromise;
 }
 
+JS::Promise<void> TestCoRoutineSingleAllocationAsync()
+{
+    size_t before = allocationCount;
+    {
+        auto promise = CoRoutineReturnImmediatelyAsync(42);
+        assert(allocationCount - before == 1, "coroutine should only allocate its frame");
+        /** The frame outlives the finished coroutine until the promise is gone */
+        int value = co_await promise;
+        assert(value == 42, "wrong result");
+    }
+    co_return;
+}
+
+static JS::Promise<int> ChainLinkAsync(JS::Promise<int> previous)
+{
+    /** Await a temporary, so the previous frame is released as soon as its value is taken */
+    int value = co_await JS::Promise<int>{std::move(previous)};
+    co_return value + 1;
+}
+
+JS::Promise<void> TestCoRoutineDeepChainAsync()
+{
+    /** Each link resumes the next one through symmetric transfer, so this must not overflow the stack */
+#ifdef __SANITIZE_ADDRESS__
+    /** AddressSanitizer disables sibling calls, so symmetric transfer grows the stack there */
+    constexpr int depth = 1000;
+#else
+    constexpr int depth = 1000000;
+#endif
+    JS::Promise<int> root{};
+    JS::Promise<int> tail = root;
+    for (int i = 0; i < depth; i++)
+    {
+        tail = ChainLinkAsync(std::move(tail));
+    }
+    root.Resolve(0);
+    int value = co_await tail;
+    assert(value == depth, "wrong result");
+}
+
 static JS::Promise<int> CoRoutineThrowImmediatelyAsync(const std::string reason)
 {
     throw std::runtime_error(reason);
@@ -336,6 +418,262 @@ JS::Promise<void> TestPromiseAllRejectAsync()
     assert(false, "should have thrown");
 }
 
+JS::Promise<void> TestPromiseAllNonCopyableAsync()
+{
+    auto promises = std::vector<JS::Promise<std::unique_ptr<int>>>{};
+    promises.push_back(ResolveNonCopyableAfterDelayAsync(200, 1));
+    promises.push_back(CoRoutineReturnNonCopyableImmediatelyAsync(2));
+    promises.push_back(CoRoutineReturnNonCopyableAfterDelayAsync(100, 3));
+    auto results = co_await JS::Promise<std::unique_ptr<int>>::All(promises);
+    assert(results.size() == 3, "size mismatch");
+    assert(*results[0] == 1, "first value mismatch");
+    assert(*results[1] == 2, "second value mismatch");
+    assert(*results[2] == 3, "third value mismatch");
+}
+
+JS::Promise<void> TestPromiseAnyRaceNonCopyableAsync()
+{
+    auto promises = std::vector<JS::Promise<std::unique_ptr<int>>>{};
+    promises.push_back(ResolveNonCopyableAfterDelayAsync(200, 1));
+    promises.push_back(CoRoutineReturnNonCopyableAfterDelayAsync(100, 2));
+    auto any = co_await JS::Promise<std::unique_ptr<int>>::Any(promises);
+    assert(*any == 2, "wrong Any result");
+
+    promises.clear();
+    promises.push_back(ResolveNonCopyableAfterDelayAsync(100, 1));
+    promises.push_back(CoRoutineReturnNonCopyableAfterDelayAsync(200, 2));
+    auto race = co_await JS::Promise<std::unique_ptr<int>>::Race(promises);
+    assert(*race == 1, "wrong Race result");
+}
+
+JS::Promise<void> TestPromiseAllAllocationsAsync()
+{
+    /** Registering callbacks should not allocate per promise */
+    auto countAllocations = [](size_t n)
+    {
+        auto promises = std::vector<JS::Promise<int>>(n);
+        size_t before = allocationCount;
+        auto all = JS::Promise<int>::All(promises);
+        size_t count = allocationCount - before;
+        for (size_t i = 0; i < n; i++)
+        {
+            promises[i].Resolve(static_cast<int>(i));
+        }
+        return count;
+    };
+    assert(countAllocations(4) == countAllocations(64), "allocations grow with the number of promises");
+    co_return;
+}
+
+/** gcc 12 cannot brace initialize arrays or initializer lists inside a coroutine body */
+template <typename T, typename... Rest>
+static std::array<T, 1 + sizeof...(Rest)> MakeArray(T first, Rest... rest)
+{
+    return {std::move(first), std::move(rest)...};
+}
+
+JS::Promise<void> TestPromiseAllRangesAsync()
+{
+    auto array = MakeArray(ResolveAfterDelayAsync(100, 1), CoRoutineReturnImmediatelyAsync(2));
+    auto results = co_await JS::Promise<int>::All(array);
+    assert(results.size() == 2 && results[0] == 1 && results[1] == 2, "std::array mismatch");
+
+    /** A view over someone else's storage. All consumes the values, so use fresh promises */
+    auto spanned = MakeArray(ResolveImmediatelyAsync(1), ResolveAfterDelayAsync(100, 2));
+    results = co_await JS::Promise<int>::All(std::span<const JS::Promise<int>>{spanned});
+    assert(results.size() == 2 && results[0] == 1 && results[1] == 2, "std::span mismatch");
+
+    auto rvalue = MakeArray(ResolveImmediatelyAsync(3), CoRoutineReturnAfterDelayAsync(100, 4));
+    results = co_await JS::Promise<int>::All(std::vector<JS::Promise<int>>(rvalue.begin(), rvalue.end()));
+    assert(results.size() == 2 && results[0] == 3 && results[1] == 4, "rvalue vector mismatch");
+
+    /** Generated on the fly, no container in between */
+    auto generated = std::views::iota(0, 8) |
+                     std::views::transform([](int i) { return CoRoutineReturnAfterDelayAsync(10 * (8 - i), i); });
+    results = co_await JS::Promise<int>::All(generated);
+    assert(results.size() == 8, "generated size mismatch");
+    for (int i = 0; i < 8; i++)
+    {
+        assert(results[i] == i, "generated value mismatch");
+    }
+
+    /** Unsized: the size is only known after the walk */
+    auto filtered = std::views::iota(0, 8) |
+                    std::views::filter([](int i) { return i % 2 == 0; }) |
+                    std::views::transform([](int i) { return ResolveAfterDelayAsync(10, i); });
+    results = co_await JS::Promise<int>::All(filtered);
+    assert(results.size() == 4 && results[3] == 6, "filtered mismatch");
+
+    auto any = co_await JS::Promise<int>::Any(MakeArray(RejectImmediatelyAsync("first"), ResolveAfterDelayAsync(100, 5)));
+    assert(any == 5, "Any over std::array mismatch");
+
+    auto race = co_await JS::Promise<int>::Race(generated);
+    assert(race == 7, "Race over generated range mismatch");
+
+    co_await JS::Promise<void>::All(MakeArray(DelayAsync(100), DelayAsync(50)));
+    co_await JS::Promise<void>::Race(std::views::iota(1, 4) |
+                                     std::views::transform([](int i) { return DelayAsync(10 * i); }));
+
+    try
+    {
+        co_await JS::Promise<int>::All(std::span<JS::Promise<int>>{});
+        assert(false, "empty range should have thrown");
+    }
+    catch (const std::invalid_argument &)
+    {
+    }
+}
+
+JS::Promise<void> TestPromiseAllSettledAsync()
+{
+    auto promises = std::vector<JS::Promise<int>>{};
+    promises.push_back(ResolveAfterDelayAsync(200, 1));
+    promises.push_back(RejectImmediatelyAsync("Error in promise 2"));
+    promises.push_back(CoRoutineReturnImmediatelyAsync(3));
+    promises.push_back(RejectAfterDelayAsync(100, "Error in promise 4"));
+    auto results = co_await JS::Promise<int>::AllSettled(promises);
+    assert(results.size() == 4, "size mismatch");
+    assert(results[0].IsFulfilled() && results[0].Value() == 1, "first value mismatch");
+    assert(results[1].IsRejected(), "second should be rejected");
+    assert(results[2].IsFulfilled() && results[2].Value() == 3, "third value mismatch");
+    assert(results[3].IsRejected() && results[3].Reason() != nullptr, "fourth should be rejected");
+    try
+    {
+        std::rethrow_exception(results[1].Reason());
+    }
+    catch (const std::runtime_error &e)
+    {
+        assert(std::string(e.what()) == "Error in promise 2", "second reason mismatch");
+    }
+
+    auto nonCopyable = std::vector<JS::Promise<std::unique_ptr<int>>>{};
+    nonCopyable.push_back(ResolveNonCopyableAfterDelayAsync(100, 1));
+    nonCopyable.push_back(CoRoutineReturnNonCopyableImmediatelyAsync(2));
+    auto pointers = co_await JS::Promise<std::unique_ptr<int>>::AllSettled(nonCopyable);
+    auto first = std::move(pointers[0]).Value();
+    assert(*first == 1 && *pointers[1].Value() == 2, "non copyable value mismatch");
+
+    auto voids = std::vector<JS::Promise<void>>{};
+    voids.push_back(DelayAsync(100));
+    voids.push_back(JS::Promise<void>{});
+    voids.back().Reject("Error in void promise");
+    auto settled = co_await JS::Promise<void>::AllSettled(voids);
+    assert(settled.size() == 2, "void size mismatch");
+    assert(settled[0].IsFulfilled() && settled[1].IsRejected(), "void outcome mismatch");
+}
+
+struct ShardError : std::runtime_error
+{
+    int shard;
+    ShardError(int shard)
+        : std::runtime_error("shard failed"), shard(shard)
+    {
+    }
+};
+
+JS::Promise<void> TestCombinatorsKeepExceptionAsync()
+{
+    auto failure = std::make_exception_ptr(ShardError{7});
+
+    JS::Promise<int> failing{};
+    std::exception_ptr caught{};
+    failing.Catch([&](const std::exception_ptr &e)
+                  { caught = e; });
+    failing.Reject(failure);
+    assert(caught == failure, "Catch should see the original exception_ptr");
+
+    JS::Promise<void> generic{};
+    std::string message{};
+    generic.Catch([&](auto &e)
+                  { message = e.what(); });
+    generic.Reject(failure);
+    assert(message == "shard failed", "A generic Catch should see the std::exception");
+
+    auto promises = std::vector<JS::Promise<int>>{};
+    promises.push_back(ResolveAfterDelayAsync(100, 1));
+    promises.push_back(JS::Promise<int>{});
+    promises.back().Reject(failure);
+    try
+    {
+        co_await JS::Promise<int>::All(promises);
+        assert(false, "All should have thrown");
+    }
+    catch (const ShardError &e)
+    {
+        assert(e.shard == 7, "All lost the exception");
+    }
+
+    promises.clear();
+    promises.push_back(ResolveAfterDelayAsync(100, 1));
+    promises.push_back(JS::Promise<int>{});
+    promises.back().Reject(failure);
+    try
+    {
+        co_await JS::Promise<int>::Race(promises);
+        assert(false, "Race should have thrown");
+    }
+    catch (const ShardError &e)
+    {
+        assert(e.shard == 7, "Race lost the exception");
+    }
+
+    JS::Promise<void> voidFailing{};
+    voidFailing.Reject(failure);
+    try
+    {
+        co_await JS::All(ResolveAfterDelayAsync(100, 1), std::move(voidFailing));
+        assert(false, "variadic All should have thrown");
+    }
+    catch (const ShardError &e)
+    {
+        assert(e.shard == 7, "variadic All lost the exception");
+    }
+}
+
+JS::Promise<void> TestVariadicAllResolveAsync()
+{
+    auto all = JS::All(
+        ResolveAfterDelayAsync(200, 1),
+        CoRoutineReturnNonCopyableAfterDelayAsync(100, 2),
+        CoRoutineReturnImmediatelyAsync(3),
+        DelayAsync(100));
+    auto [first, second, third, fourth] = co_await all;
+    assert(first == 1, "first value mismatch");
+    assert(second && *second == 2, "second value mismatch");
+    assert(third == 3, "third value mismatch");
+    (void)fourth;
+}
+
+JS::Promise<void> TestVariadicAllAllocationsAsync()
+{
+    JS::Promise<int> first{};
+    JS::Promise<std::unique_ptr<int>> second{};
+    size_t before = allocationCount;
+    auto all = JS::All(first, second);
+    assert(allocationCount - before == 1, "variadic All should allocate once");
+    first.Resolve(1);
+    second.Resolve(std::make_unique<int>(2));
+    auto [a, b] = co_await all;
+    assert(a == 1 && *b == 2, "wrong result");
+}
+
+JS::Promise<void> TestVariadicAllRejectAsync()
+{
+    try
+    {
+        co_await JS::All(
+            ResolveAfterDelayAsync(100, 1),
+            CoRoutineThrowAfterDelayAsync(200, "Error in promise 2"),
+            CoRoutineReturnNonCopyableAfterDelayAsync(300, 3));
+    }
+    catch (const std::exception &e)
+    {
+        assert(std::string(e.what()) == "Error in promise 2", "wrong promise rejection reason");
+        co_return;
+    }
+    assert(false, "should have thrown");
+}
+
 JS::Promise<void> TestPromiseAnyResolveImmediatelyAsync()
 {
     auto promises = std::vector<JS::Promise<int>>{};
@@ -453,17 +791,71 @@ JS::Promise<void> TestPromiseRaceRejectAsync()
     assert(false, "should have thrown");
 }
 
+/** Resumed by a timer, with a value */
+struct ValueAwaiter
+{
+    int value;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle) const
+    {
+        tev.SetTimeout([handle]()
+                       { handle.resume(); }, 1);
+    }
+    int await_resume() const noexcept
+    {
+        return value;
+    }
+};
+
+/** Awaitable only through operator co_await, like many third party types */
+struct MemberCoAwait
+{
+    int value;
+
+    ValueAwaiter operator co_await() const
+    {
+        return ValueAwaiter{value};
+    }
+};
+
+struct FreeCoAwait
+{
+    int value;
+};
+
+ValueAwaiter operator co_await(const FreeCoAwait &awaitable)
+{
+    return ValueAwaiter{awaitable.value * 2};
+}
+
+JS::Promise<void> TestOperatorCoAwaitAsync()
+{
+    int member = co_await MemberCoAwait{1};
+    FreeCoAwait free{2};
+    int viaFree = co_await free;
+    int plain = co_await ValueAwaiter{3};
+    assert(member == 1 && viaFree == 4 && plain == 3, "wrong awaiter used");
+}
+
 JS::Promise<void> TestAsync()
 {
     RunAsyncTest(TestResolveAsync);
+    RunAsyncTest(TestOperatorCoAwaitAsync);
     RunAsyncTest(TestThenImmediateAsync);
     RunAsyncTest(TestThenAsync);
+    RunAsyncTest(TestThenMoveOnlyCaptureAsync);
     RunAsyncTest(TestRejectAsync);
     RunAsyncTest(TestCatchImmediatelyAsync);
     RunAsyncTest(TestCatchAsync);
     RunAsyncTest(TestCoRoutineReturnAsync);
     RunAsyncTest(TestCoRoutineThenImmediateAsync);
     RunAsyncTest(TestCoRoutineThenAsync);
+    RunAsyncTest(TestCoRoutineSingleAllocationAsync);
+    RunAsyncTest(TestCoRoutineDeepChainAsync);
     RunAsyncTest(TestCoRoutineThrowAsync);
     /** Catch does not work on a immediately thrown coroutine */
     RunAsyncTest(TestCoRoutineCatchAsync);
@@ -471,6 +863,15 @@ JS::Promise<void> TestAsync()
     RunAsyncTest(TestPromiseAllResolveAsync);
     RunAsyncTest(TestPromiseAllRejectImmediatelyAsync);
     RunAsyncTest(TestPromiseAllRejectAsync);
+    RunAsyncTest(TestPromiseAllNonCopyableAsync);
+    RunAsyncTest(TestPromiseAnyRaceNonCopyableAsync);
+    RunAsyncTest(TestPromiseAllAllocationsAsync);
+    RunAsyncTest(TestPromiseAllRangesAsync);
+    RunAsyncTest(TestPromiseAllSettledAsync);
+    RunAsyncTest(TestCombinatorsKeepExceptionAsync);
+    RunAsyncTest(TestVariadicAllResolveAsync);
+    RunAsyncTest(TestVariadicAllAllocationsAsync);
+    RunAsyncTest(TestVariadicAllRejectAsync);
     RunAsyncTest(TestPromiseAnyResolveImmediatelyAsync);
     RunAsyncTest(TestPromiseAnyResolveAsync);
     RunAsyncTest(TestPromiseAnyRejectImmediatelyAsync);
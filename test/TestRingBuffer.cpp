@@ -0,0 +1,123 @@
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include "../include/RingBuffer.h"
+#include "TestUtility.h"
+
+static void TestWrapAndGrow()
+{
+    /** Compared against std::deque through pushes and pops that wrap around while growing */
+    JS::Detail::RingBuffer<int> ring{};
+    std::deque<int> expected{};
+    std::mt19937 random{3};
+    int next = 0;
+    for (int round = 0; round < 10000; round++)
+    {
+        int pushes = static_cast<int>(random() % 8);
+        for (int i = 0; i < pushes; i++)
+        {
+            ring.Push(next);
+            expected.push_back(next);
+            next++;
+        }
+        int pops = static_cast<int>(random() % 8);
+        for (int i = 0; i < pops && !expected.empty(); i++)
+        {
+            assert(ring.Front() == expected.front(), "wrong order");
+            ring.Pop();
+            expected.pop_front();
+        }
+        assert(ring.Size() == expected.size(), "wrong size");
+    }
+    size_t capacity = ring.Capacity();
+    assert((capacity & (capacity - 1)) == 0 && capacity >= ring.Size(), "capacity should be a power of two");
+}
+
+struct Counted
+{
+    static inline int alive = 0;
+    std::unique_ptr<int> value;
+
+    explicit Counted(int v)
+        : value(std::make_unique<int>(v))
+    {
+        alive++;
+    }
+    Counted(Counted &&other) noexcept
+        : value(std::move(other.value))
+    {
+        alive++;
+    }
+    ~Counted()
+    {
+        alive--;
+    }
+};
+
+static void TestLifetimes()
+{
+    {
+        JS::Detail::RingBuffer<Counted> ring{};
+        for (int i = 0; i < 100; i++)
+        {
+            ring.Emplace(i);
+            if (i % 3 == 0)
+            {
+                ring.Pop();
+            }
+        }
+        assert(Counted::alive == static_cast<int>(ring.Size()), "values leaked or destroyed twice");
+        auto moved = std::move(ring);
+        assert(ring.Empty() && moved.Size() == 66, "move lost values");
+        assert(*moved.Front().value == 34, "wrong front after move");
+    }
+    assert(Counted::alive == 0, "values leaked");
+}
+
+static void TestInline()
+{
+    JS::Detail::RingBuffer<std::unique_ptr<int>, 4> ring{};
+    assert(ring.Capacity() == 4, "wrong inline capacity");
+    int next = 0;
+    int expected = 0;
+    for (int round = 0; round < 10; round++)
+    {
+        while (ring.Size() < ring.Capacity())
+        {
+            ring.Push(std::make_unique<int>(next++));
+        }
+        try
+        {
+            ring.Push(std::make_unique<int>(-1));
+            assert(false, "pushing into a full inline ring should throw");
+        }
+        catch (const std::length_error &)
+        {
+        }
+        /** Leave one behind, so the next round wraps */
+        for (int i = 0; i < 3; i++)
+        {
+            assert(*ring.Front() == expected++, "wrong order");
+            ring.Pop();
+        }
+    }
+    ring.Clear();
+    ring.Push(std::make_unique<int>(7));
+    auto moved = std::move(ring);
+    assert(moved.Size() == 1 && *moved.Front() == 7, "move lost values");
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    TestWrapAndGrow();
+    TestLifetimes();
+    TestInline();
+
+    std::cout << "RingBuffer tests completed successfully." << std::endl;
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/EventLoop.h"
+#include "../include/Scheduler.h"
+#include "TestUtility.h"
+
+static JS::EventLoop loop{};
+static JS::Scheduler scheduler{4};
+
+static JS::Task<std::thread::id> ThreadIdTask()
+{
+    co_await scheduler.Schedule();
+    co_return std::this_thread::get_id();
+}
+
+static JS::Task<uint64_t> FibTask(int n)
+{
+    if (n < 12)
+    {
+        uint64_t a = 0, b = 1;
+        for (int i = 0; i < n; i++)
+        {
+            b = std::exchange(a, b) + b;
+        }
+        co_return a;
+    }
+    /** One half goes to the deque to be stolen, the other runs right here */
+    auto left = scheduler.Spawn(FibTask(n - 1));
+    uint64_t right = co_await FibTask(n - 2);
+    co_return co_await left + right;
+}
+
+static JS::Task<int> ThrowTask(const std::string reason)
+{
+    co_await scheduler.Schedule();
+    throw std::runtime_error(reason);
+}
+
+static JS::Task<int> LocalPromiseTask()
+{
+    /** A plain promise resolved and awaited on the same worker */
+    JS::Promise<int> promise{};
+    auto resolver = [](JS::Promise<int> promise) -> JS::Promise<void>
+    {
+        promise.Resolve(42);
+        co_return;
+    };
+    co_await scheduler.Schedule();
+    resolver(promise);
+    co_return co_await promise;
+}
+
+static JS::Task<void> CountTask(std::atomic<int> &counter)
+{
+    co_await scheduler.Schedule();
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+JS::Promise<void> TestScheduleAsync()
+{
+    auto loopThread = std::this_thread::get_id();
+    auto workerThread = co_await scheduler.Spawn(ThreadIdTask());
+    assert(workerThread != loopThread, "task did not run on the pool");
+    assert(std::this_thread::get_id() == loopThread, "resumed off the loop thread");
+}
+
+JS::Promise<void> TestSpawnFibAsync()
+{
+    auto value = co_await scheduler.Spawn(FibTask(25));
+    assert(value == 75025, "wrong fib");
+}
+
+JS::Promise<void> TestSpawnThrowAsync()
+{
+    try
+    {
+        co_await scheduler.Spawn(ThrowTask("Pool throw"));
+        assert(false, "should have thrown");
+    }
+    catch (const std::exception &e)
+    {
+        assert(std::string(e.what()) == "Pool throw", "wrong reason");
+    }
+}
+
+JS::Promise<void> TestLocalPromiseAsync()
+{
+    int value = co_await scheduler.Spawn(LocalPromiseTask());
+    assert(value == 42, "wrong value");
+}
+
+JS::Promise<void> TestManySpawnsAsync()
+{
+    std::atomic<int> counter{0};
+    std::vector<JS::ThreadSafePromise<void>> promises{};
+    for (int i = 0; i < 10000; i++)
+    {
+        promises.push_back(scheduler.Spawn(CountTask(counter)));
+    }
+    for (auto &promise : promises)
+    {
+        co_await promise;
+    }
+    assert(counter.load() == 10000, "lost tasks");
+}
+
+JS::Promise<void> TestAsync()
+{
+    RunAsyncTest(TestScheduleAsync);
+    RunAsyncTest(TestSpawnFibAsync);
+    RunAsyncTest(TestSpawnThrowAsync);
+    RunAsyncTest(TestLocalPromiseAsync);
+    RunAsyncTest(TestManySpawnsAsync);
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    /** Installed before the test starts, so even its first await comes back to the loop */
+    JS::ScopedExecutor scope{loop};
+    loop.RunUntilComplete(TestAsync());
+
+    return 0;
+}
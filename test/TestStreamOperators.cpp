@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../include/AsyncGenerator.h"
+#include "../include/Cancellation.h"
+#include "../include/EventLoop.h"
+#include "../include/StreamOperators.h"
+#include "../include/TimerWheel.h"
+#include "TestUtility.h"
+
+static JS::EventLoop loop{};
+
+static JS::AsyncGenerator<int> CountAsync(int count, int delayMs)
+{
+    for (int i = 0; i < count; i++)
+    {
+        co_yield i;
+        if (delayMs)
+        {
+            co_await JS::Delay(delayMs);
+        }
+    }
+}
+
+template <typename T>
+static JS::Promise<std::vector<T>> CollectAsync(JS::AsyncGenerator<T> generator)
+{
+    std::vector<T> values{};
+    while (auto value = co_await generator.NextAsync())
+    {
+        values.push_back(std::move(*value));
+    }
+    co_return values;
+}
+
+JS::Promise<void> TestChainAsync()
+{
+    JS::AsyncGenerator<std::vector<int>> chunks = CountAsync(100, 1) |
+                                                 JS::Filter([](const int &n)
+                                                            { return n % 2 == 0; }) |
+                                                 JS::Map([](int n)
+                                                         { return n * n; }) |
+                                                 JS::Take(7) |
+                                                 JS::Chunk(3);
+    auto values = co_await CollectAsync(std::move(chunks));
+    std::vector<std::vector<int>> expected{};
+    expected.push_back(std::vector<int>{0, 4, 16});
+    expected.push_back(std::vector<int>{36, 64, 100});
+    expected.push_back(std::vector<int>{144});
+    assert(values == expected, "wrong chunks");
+}
+
+JS::Promise<void> TestMapTypesAsync()
+{
+    JS::AsyncGenerator<std::string> strings = CountAsync(3, 0) |
+                                              JS::Map([](int n)
+                                                      { return std::to_string(n); }) |
+                                              JS::Map([](std::string s)
+                                                      { return s + s; });
+    auto values = co_await CollectAsync(std::move(strings));
+    assert((values == std::vector<std::string>{"00", "11", "22"}), "wrong mapped values");
+}
+
+JS::Promise<void> TestInlineSourceAsync()
+{
+    JS::AsyncGenerator<int, void, 8> source{};
+    for (int i = 0; i < 4; i++)
+    {
+        source.Feed(i);
+    }
+    source.Finish();
+    JS::AsyncGenerator<int> doubled = source | JS::Map([](int n)
+                                                       { return n * 2; });
+    auto values = co_await CollectAsync(std::move(doubled));
+    assert((values == std::vector<int>{0, 2, 4, 6}), "wrong values from an inline source");
+}
+
+JS::Promise<void> TestTakeStopsReadingAsync()
+{
+    JS::AsyncGenerator<int> source{};
+    for (int i = 0; i < 10; i++)
+    {
+        source.Feed(i);
+    }
+    JS::AsyncGenerator<int> firstThree = source | JS::Take(3);
+    auto values = co_await CollectAsync(std::move(firstThree));
+    assert((values == std::vector<int>{0, 1, 2}), "wrong values taken");
+    auto next = co_await source.NextAsync();
+    assert(next.value() == 3, "Take read past what it needed");
+    source.Finish();
+}
+
+JS::Promise<void> TestExceptionAsync()
+{
+    JS::AsyncGenerator<int> failing = CountAsync(5, 1) |
+                                      JS::Map([](int n)
+                                              {
+        if (n == 2)
+        {
+            throw std::runtime_error("bad value");
+        }
+        return n; });
+    try
+    {
+        co_await CollectAsync(std::move(failing));
+        assert(false, "should have thrown");
+    }
+    catch (const std::runtime_error &e)
+    {
+        assert(std::string(e.what()) == "bad value", "wrong exception");
+    }
+    /** The source keeps producing into its buffer, let it finish */
+    co_await JS::Delay(10);
+}
+
+static JS::Promise<int> SlowSquareAsync(int n, int &inFlight, int &maxInFlight)
+{
+    inFlight++;
+    maxInFlight = std::max(maxInFlight, inFlight);
+    /** Later values finish first */
+    co_await JS::Delay(static_cast<uint64_t>(50 - 5 * (n % 10)));
+    inFlight--;
+    co_return n * n;
+}
+
+JS::Promise<void> TestMapConcurrentOrderedAsync()
+{
+    int inFlight = 0;
+    int maxInFlight = 0;
+    auto squares = JS::MapConcurrent(
+        CountAsync(20, 0), [&](int n)
+        { return SlowSquareAsync(n, inFlight, maxInFlight); },
+        4);
+    auto values = co_await CollectAsync(std::move(squares));
+    assert(values.size() == 20, "values lost");
+    for (int i = 0; i < 20; i++)
+    {
+        assert(values[i] == i * i, "not in input order");
+    }
+    assert(maxInFlight == 4, "concurrency limit not used or exceeded: " + std::to_string(maxInFlight));
+}
+
+JS::Promise<void> TestMapConcurrentUnorderedAsync()
+{
+    int inFlight = 0;
+    int maxInFlight = 0;
+    auto squares = JS::MapConcurrent(
+        CountAsync(4, 0), [&](int n)
+        { return SlowSquareAsync(n, inFlight, maxInFlight); },
+        4, false);
+    auto values = co_await CollectAsync(std::move(squares));
+    assert((values == std::vector<int>{9, 4, 1, 0}), "not in completion order");
+}
+
+static JS::AsyncGenerator<int> CountBoundedAsync(JS::GeneratorCapacity capacity, int count, int &produced)
+{
+    (void)capacity;
+    for (int i = 0; i < count; i++)
+    {
+        produced++;
+        co_yield i;
+    }
+}
+
+static JS::Promise<int> IdentityAsync(int n)
+{
+    co_await JS::Delay(1);
+    co_return n;
+}
+
+JS::Promise<void> TestMapConcurrentBackpressureAsync()
+{
+    int produced = 0;
+    auto mapped = JS::MapConcurrent(CountBoundedAsync(JS::GeneratorCapacity{2}, 50, produced), IdentityAsync, 3);
+    int consumed = 0;
+    while (auto value = co_await mapped.NextAsync())
+    {
+        assert(*value == consumed, "wrong value");
+        consumed++;
+        /** A slow consumer: the limit bounds the calls and the results together, then the source buffers 2 */
+        co_await JS::Delay(2);
+        assert(produced - consumed <= 3 + 2 + 1, "source read too far ahead: " + std::to_string(produced - consumed));
+    }
+    assert(consumed == 50, "values lost");
+}
+
+static JS::Promise<int> FailOnThreeAsync(int n)
+{
+    co_await JS::Delay(1);
+    if (n == 3)
+    {
+        throw std::runtime_error("three");
+    }
+    co_return n;
+}
+
+static JS::Promise<int> FailFirstAsync(int n, int &cancelled)
+{
+    auto token = co_await JS::CurrentCancellationToken();
+    JS::CancellationRegistration registration{token, [&]()
+                                              { cancelled++; }};
+    co_await JS::Delay(n == 0 ? 1 : 1000);
+    if (n == 0)
+    {
+        throw std::runtime_error("first");
+    }
+    co_return n;
+}
+
+JS::Promise<void> TestMapConcurrentFailureAsync()
+{
+    int cancelled = 0;
+    auto failing = JS::MapConcurrent(
+        CountAsync(10, 0), [&](int n)
+        { return FailFirstAsync(n, cancelled); },
+        3);
+    try
+    {
+        co_await CollectAsync(std::move(failing));
+        assert(false, "should have thrown");
+    }
+    catch (const std::runtime_error &e)
+    {
+        assert(std::string(e.what()) == "first", "wrong exception");
+    }
+    assert(cancelled == 2, "calls in flight not cancelled: " + std::to_string(cancelled));
+    /** Let the cancelled calls unwind */
+    co_await JS::Delay(5);
+
+    auto mapped = JS::MapConcurrent(CountAsync(10, 0), FailOnThreeAsync, 2);
+    try
+    {
+        co_await CollectAsync(std::move(mapped));
+        assert(false, "should have thrown");
+    }
+    catch (const std::runtime_error &e)
+    {
+        assert(std::string(e.what()) == "three", "wrong exception");
+    }
+    /** Let the calls in flight finish */
+    co_await JS::Delay(10);
+}
+
+JS::Promise<void> TestMergeTakesTurnsAsync()
+{
+    JS::AsyncGenerator<int> a{};
+    JS::AsyncGenerator<int> b{};
+    JS::AsyncGenerator<int, std::string> c{};
+    for (int i = 0; i < 5; i++)
+    {
+        a.Feed(i);
+    }
+    b.Feed(10);
+    b.Feed(11);
+    for (int i = 20; i < 23; i++)
+    {
+        c.Feed(i);
+    }
+    a.Finish();
+    b.Finish();
+    c.Finish("dropped");
+    auto values = co_await CollectAsync(JS::Merge(a, b, c));
+    assert((values == std::vector<int>{0, 10, 20, 1, 11, 21, 2, 22, 3, 4}), "sources did not take turns");
+}
+
+static JS::AsyncGenerator<int> CountFromAsync(int from, int count, int delayMs)
+{
+    for (int i = from; i < from + count; i++)
+    {
+        co_await JS::Delay(delayMs);
+        co_yield i;
+    }
+}
+
+JS::Promise<void> TestMergeTimedAsync()
+{
+    std::vector<JS::AsyncGenerator<int>> shards{};
+    shards.push_back(CountFromAsync(0, 20, 1));
+    shards.push_back(CountFromAsync(100, 5, 10));
+    shards.push_back(CountFromAsync(200, 0, 1));
+    auto values = co_await CollectAsync(JS::Merge(std::move(shards)));
+    assert(values.size() == 25, "values lost");
+    /** Each source stays in order, and the slow one is not left to the end */
+    std::vector<int> fast{};
+    std::vector<int> slow{};
+    for (int value : values)
+    {
+        (value < 100 ? fast : slow).push_back(value);
+    }
+    assert(std::is_sorted(fast.begin(), fast.end()) && std::is_sorted(slow.begin(), slow.end()), "source out of order");
+    assert(values.front() == 0 && values.back() == 104, "wrong interleaving");
+    assert(std::find(values.begin(), values.end(), 100) < std::find(values.begin(), values.end(), 19), "slow source starved");
+
+    auto none = co_await CollectAsync(JS::Merge(std::vector<JS::AsyncGenerator<int>>{}));
+    assert(none.empty(), "merge of nothing should end right away");
+}
+
+static JS::AsyncGenerator<int> FailAfterAsync(int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        co_await JS::Delay(1);
+        co_yield i;
+    }
+    throw std::runtime_error("shard failed");
+}
+
+JS::Promise<void> TestMergeFailureAsync()
+{
+    auto merged = JS::Merge(FailAfterAsync(3), CountFromAsync(100, 10, 1));
+    int count = 0;
+    try
+    {
+        while (co_await merged.NextAsync())
+        {
+            count++;
+        }
+        assert(false, "should have thrown");
+    }
+    catch (const std::runtime_error &e)
+    {
+        assert(std::string(e.what()) == "shard failed", "wrong exception");
+    }
+    assert(count >= 3, "values before the failure lost");
+    /** Let the other source finish */
+    co_await JS::Delay(20);
+}
+
+JS::Promise<void> TestMergeFailureWhileQueuedAsync()
+{
+    JS::AsyncGenerator<int> a{};
+    JS::AsyncGenerator<int> b{};
+    a.Feed(1);
+    a.Feed(2);
+    auto merged = JS::Merge(a, b);
+    b.Reject("shard failed");
+    std::vector<int> values{};
+    try
+    {
+        while (auto value = co_await merged.NextAsync())
+        {
+            values.push_back(*value);
+        }
+        assert(false, "should have thrown");
+    }
+    catch (const std::exception &)
+    {
+    }
+    /** What was queued before the failure is still yielded */
+    assert(!values.empty() && values.size() <= 2 && values[0] == 1 && values.back() == static_cast<int>(values.size()), "queued value lost");
+    a.Finish();
+}
+
+JS::Promise<void> TestAsync()
+{
+    RunAsyncTest(TestChainAsync);
+    RunAsyncTest(TestMapTypesAsync);
+    RunAsyncTest(TestInlineSourceAsync);
+    RunAsyncTest(TestTakeStopsReadingAsync);
+    RunAsyncTest(TestExceptionAsync);
+    RunAsyncTest(TestMapConcurrentOrderedAsync);
+    RunAsyncTest(TestMapConcurrentUnorderedAsync);
+    RunAsyncTest(TestMapConcurrentBackpressureAsync);
+    RunAsyncTest(TestMapConcurrentFailureAsync);
+    RunAsyncTest(TestMergeTakesTurnsAsync);
+    RunAsyncTest(TestMergeTimedAsync);
+    RunAsyncTest(TestMergeFailureAsync);
+    RunAsyncTest(TestMergeFailureWhileQueuedAsync);
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    JS::ScopedTimerWheel timers{loop.Timers()};
+    loop.RunUntilComplete(TestAsync());
+
+    std::cout << "StreamOperators tests completed successfully." << std::endl;
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <tev-cpp/Tev.h>
+#include "../include/Promise.h"
+#include "../include/Task.h"
+#include "TestUtility.h"
+
+static Tev tev{};
+
+static size_t allocationCount = 0;
+
+/** Not inlined, otherwise gcc pairs the inlined free() with operator new and warns */
+[[gnu::noinline]] void *operator new(size_t size)
+{
+    allocationCount++;
+    if (void *ptr = std::malloc(size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+static JS::Promise<void> DelayAsync(int ms)
+{
+    JS::Promise<void> promise{};
+    tev.SetTimeout([=]() {
+        promise.Resolve();
+    }, ms);
+    return promise;
+}
+
+static JS::Task<int> ReturnTask(int value)
+{
+    co_return value;
+}
+
+static JS::Task<int> ReturnAfterDelayTask(int ms, int value)
+{
+    co_await DelayAsync(ms);
+    co_return value;
+}
+
+static JS::Task<std::unique_ptr<int>> ReturnNonCopyableTask(int value)
+{
+    co_return std::make_unique<int>(value);
+}
+
+static JS::Task<int> ThrowTask(const std::string reason)
+{
+    co_await DelayAsync(100);
+    throw std::runtime_error(reason);
+}
+
+static JS::Task<void> SetAfterDelayTask(int ms, int &target, int value)
+{
+    co_await DelayAsync(ms);
+    target = value;
+}
+
+static JS::Task<int> DepthTask(int depth)
+{
+    if (depth == 0)
+    {
+        co_return 0;
+    }
+    co_return co_await DepthTask(depth - 1) + 1;
+}
+
+JS::Promise<void> TestTaskReturnAsync()
+{
+    int value = co_await ReturnTask(42);
+    assert(value == 42, "ReturnTask");
+
+    value = co_await ReturnAfterDelayTask(100, 42);
+    assert(value == 42, "ReturnAfterDelayTask");
+
+    auto ptr = co_await ReturnNonCopyableTask(42);
+    assert(ptr && *ptr == 42, "ReturnNonCopyableTask");
+}
+
+JS::Promise<void> TestTaskIsLazyAsync()
+{
+    int target = 0;
+    auto task = SetAfterDelayTask(0, target, 42);
+    /** Nothing runs before the task is awaited, not even the delay */
+    co_await DelayAsync(100);
+    assert(target == 0, "task started before being awaited");
+    co_await task;
+    assert(target == 42, "task did not run");
+}
+
+JS::Promise<void> TestTaskThrowAsync()
+{
+    try
+    {
+        co_await ThrowTask("Delayed throw");
+        assert(false, "ThrowTask should have thrown");
+    }
+    catch (const std::exception &e)
+    {
+        assert(std::string(e.what()) == "Delayed throw", "ThrowTask wrong reason");
+    }
+}
+
+JS::Promise<void> TestTaskSingleAllocationAsync()
+{
+    size_t before = allocationCount;
+    int value = co_await ReturnTask(42);
+    assert(allocationCount - before == 1, "awaiting a task should only allocate its frame");
+    assert(value == 42, "wrong result");
+}
+
+JS::Promise<void> TestTaskDeepRecursionAsync()
+{
+    /** Awaiting a child and completing both go through symmetric transfer */
+#ifdef __SANITIZE_ADDRESS__
+    /** AddressSanitizer disables sibling calls, so symmetric transfer grows the stack there */
+    constexpr int depth = 1000;
+#else
+    constexpr int depth = 1000000;
+#endif
+    int value = co_await DepthTask(depth);
+    assert(value == depth, "wrong result");
+}
+
+JS::Promise<void> TestAsync()
+{
+    RunAsyncTest(TestTaskReturnAsync);
+    RunAsyncTest(TestTaskIsLazyAsync);
+    RunAsyncTest(TestTaskThrowAsync);
+    RunAsyncTest(TestTaskSingleAllocationAsync);
+    RunAsyncTest(TestTaskDeepRecursionAsync);
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    TestAsync();
+
+    tev.MainLoop();
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/Promise.h"
+#include "../include/ThreadSafePromise.h"
+#include "TestUtility.h"
+
+/** The awaiting thread's loop. Post may come from any thread. */
+class LoopExecutor : public JS::Executor
+{
+public:
+    void Post(std::coroutine_handle<> handle) override
+    {
+        {
+            std::lock_guard lock{_mutex};
+            _ready.push_back(handle);
+        }
+        _cv.notify_one();
+    }
+
+    void RunUntil(const bool &done)
+    {
+        while (!done)
+        {
+            std::coroutine_handle<> handle{};
+            {
+                std::unique_lock lock{_mutex};
+                _cv.wait(lock, [&]
+                         { return !_ready.empty(); });
+                handle = _ready.front();
+                _ready.pop_front();
+            }
+            handle.resume();
+        }
+    }
+
+private:
+    std::mutex _mutex{};
+    std::condition_variable _cv{};
+    std::deque<std::coroutine_handle<>> _ready{};
+};
+
+static std::thread::id loopThread{};
+static std::vector<std::thread> workers{};
+
+static JS::ThreadSafePromise<int> SquareOnWorker(int value)
+{
+    JS::ThreadSafePromise<int> promise{};
+    workers.emplace_back([=]()
+                         { promise.Resolve(value * value); });
+    return promise;
+}
+
+JS::Promise<void> TestResolveFromWorkerAsync()
+{
+    int result = co_await SquareOnWorker(7);
+    assert(result == 49, "wrong result");
+    assert(std::this_thread::get_id() == loopThread, "resumed off the loop thread");
+}
+
+JS::Promise<void> TestRejectFromWorkerAsync()
+{
+    JS::ThreadSafePromise<void> promise{};
+    workers.emplace_back([=]()
+                         { promise.Reject("worker failed"); });
+    try
+    {
+        co_await promise;
+        assert(false, "should have thrown");
+    }
+    catch (const std::exception &e)
+    {
+        assert(std::string(e.what()) == "worker failed", "wrong reason");
+    }
+    assert(std::this_thread::get_id() == loopThread, "resumed off the loop thread");
+}
+
+JS::Promise<void> TestFirstResolveWinsAsync()
+{
+    JS::ThreadSafePromise<int> promise{};
+    for (int i = 0; i < 4; i++)
+    {
+        workers.emplace_back([=]()
+                             { promise.Resolve(1); });
+    }
+    int result = co_await promise;
+    assert(result == 1, "wrong result");
+}
+
+JS::Promise<void> TestResolveRaceAsync()
+{
+    /** Resolves land before, during and after await_suspend */
+    for (int i = 0; i < 2000; i++)
+    {
+        int result = co_await SquareOnWorker(i);
+        assert(result == i * i, "wrong result");
+        assert(std::this_thread::get_id() == loopThread, "resumed off the loop thread");
+    }
+}
+
+JS::Promise<void> TestAsync()
+{
+    RunAsyncTest(TestResolveFromWorkerAsync);
+    RunAsyncTest(TestRejectFromWorkerAsync);
+    RunAsyncTest(TestFirstResolveWinsAsync);
+    RunAsyncTest(TestResolveRaceAsync);
+}
+
+static JS::Promise<int> AwaitAsync(JS::ThreadSafePromise<int> promise)
+{
+    co_return co_await promise;
+}
+
+static void TestNoExecutor()
+{
+    /** The resolver's thread would be the only place left to resume on */
+    JS::ThreadSafePromise<int> pending{};
+    bool threw = false;
+    AwaitAsync(pending).Catch([&](const std::exception_ptr &e)
+                              {
+        try
+        {
+            std::rethrow_exception(e);
+        }
+        catch (const std::logic_error &)
+        {
+            threw = true;
+        }
+        catch (...)
+        {
+        } });
+    assert(threw, "awaiting without an executor should throw");
+
+    /** Nothing to resume when it already settled */
+    JS::ThreadSafePromise<int> settled{};
+    settled.Resolve(3);
+    int value = 0;
+    AwaitAsync(settled).Then([&](int v)
+                             { value = v; });
+    assert(value == 3, "settled promise should not need an executor");
+}
+
+static JS::Promise<void> MarkDoneAsync(JS::Promise<void> test, bool &done)
+{
+    co_await test;
+    done = true;
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    TestNoExecutor();
+
+    loopThread = std::this_thread::get_id();
+    LoopExecutor executor{};
+    JS::ScopedExecutor scope{executor};
+    bool done = false;
+    auto test = MarkDoneAsync(TestAsync(), done);
+    executor.RunUntil(done);
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    return 0;
+}
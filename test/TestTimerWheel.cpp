@@ -0,0 +1,195 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../include/EventLoop.h"
+#include "../include/TimerWheel.h"
+#include "TestUtility.h"
+
+using namespace std::chrono_literals;
+using Clock = JS::TimerWheel::Clock;
+
+/** The wheel is driven with made up times, so these run instantly */
+static const Clock::time_point start = Clock::now();
+
+static void TestFireOrder()
+{
+    JS::TimerWheel wheel{start};
+    std::vector<int> order{};
+    wheel.SetTimeout([&]()
+                     { order.push_back(3); },
+                     300, start);
+    wheel.SetTimeout([&]()
+                     { order.push_back(1); },
+                     10, start);
+    wheel.SetTimeout([&]()
+                     { order.push_back(2); },
+                     10, start);
+    auto cleared = wheel.SetTimeout([&]()
+                                    { order.push_back(0); },
+                                    20, start);
+    wheel.ClearTimeout(cleared);
+    wheel.ClearTimeout(cleared);
+    assert(wheel.Size() == 3, "wrong size");
+    assert(wheel.Advance(start + 9ms) == 0, "fired early");
+    assert(wheel.Advance(start + 10ms) == 2, "should fire both 10 ms timers");
+    assert(wheel.Advance(start + 1s) == 1, "should fire the 300 ms timer");
+    assert((order == std::vector<int>{1, 2, 3}), "timers fired out of order");
+    assert(wheel.Empty(), "should be empty");
+    assert(!wheel.NextDeadline(), "no deadline when empty");
+}
+
+static void TestFarTimers()
+{
+    /** Each lands on a different level and has to cascade down */
+    JS::TimerWheel wheel{start};
+    std::vector<uint64_t> delays{1, 255, 256, 257, 65535, 65536, 70000, 16777216, 20000000, 5000000000};
+    std::vector<uint64_t> fired{};
+    for (auto ms : delays)
+    {
+        wheel.SetTimeout([&, ms]()
+                         { fired.push_back(ms); },
+                         ms, start);
+    }
+    for (auto ms : delays)
+    {
+        auto deadline = wheel.NextDeadline();
+        assert(deadline && *deadline <= start + std::chrono::milliseconds(ms), "deadline past the next timer");
+        wheel.Advance(start + std::chrono::milliseconds(ms - 1));
+        assert(fired.size() < delays.size() && (fired.empty() || fired.back() < ms), "fired early");
+        wheel.Advance(start + std::chrono::milliseconds(ms));
+        assert(!fired.empty() && fired.back() == ms, "did not fire on time: " + std::to_string(ms));
+    }
+    assert(fired == delays, "wrong order");
+}
+
+static void TestClearWhileFiring()
+{
+    JS::TimerWheel wheel{start};
+    int count = 0;
+    JS::TimerWheel::TimeoutHandle second{};
+    wheel.SetTimeout([&]()
+                     {
+        count++;
+        wheel.ClearTimeout(second); },
+                     0, start);
+    second = wheel.SetTimeout([&]()
+                              { count += 10; },
+                              0, start);
+    /** A 0 ms timeout set while firing waits for the next Advance */
+    wheel.SetTimeout([&]()
+                     { wheel.SetTimeout([&]()
+                                        { count += 100; },
+                                        0, start); },
+                     5, start);
+    wheel.Advance(start);
+    assert(count == 1, "cleared timer fired");
+    wheel.Advance(start + 5ms);
+    assert(count == 1, "0 ms timer fired in the same Advance");
+    wheel.Advance(start + 5ms);
+    assert(count == 101, "0 ms timer did not fire");
+}
+
+static void TestRandomAgainstSorted()
+{
+    /** Timers must fire at their deadline, whatever the mix of levels and clears */
+    JS::TimerWheel wheel{start};
+    std::mt19937 random{7};
+    std::uniform_int_distribution<uint64_t> delay{1, 200000};
+    uint64_t now = 0;
+    uint64_t previous = 0;
+    size_t expected = 0;
+    size_t fired = 0;
+    std::vector<JS::TimerWheel::TimeoutHandle> handles{};
+    for (int round = 0; round < 200; round++)
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            uint64_t deadline = now + delay(random);
+            handles.push_back(wheel.SetTimeout([&, deadline]()
+                                               {
+                assert(deadline > previous && deadline <= now, "fired at the wrong tick");
+                fired++; },
+                                               deadline - now, start + std::chrono::milliseconds(now)));
+            expected++;
+        }
+        for (int i = 0; i < 50; i++)
+        {
+            size_t size = wheel.Size();
+            wheel.ClearTimeout(handles[random() % handles.size()]);
+            expected -= size - wheel.Size();
+        }
+        /** Step tick by tick, or jump far ahead */
+        uint64_t until = now + (round % 2 ? 300 : 50000);
+        while (now < until)
+        {
+            previous = now;
+            now = round % 2 ? now + 1 : until;
+            wheel.Advance(start + std::chrono::milliseconds(now));
+        }
+    }
+    while (!wheel.Empty())
+    {
+        previous = now;
+        now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(*wheel.NextDeadline() - start).count());
+        wheel.Advance(start + std::chrono::milliseconds(now));
+    }
+    assert(fired == expected, "lost timers");
+}
+
+static JS::EventLoop loop{};
+
+static JS::Promise<int> ReturnAfterDelayAsync(int ms, int value)
+{
+    co_await JS::Delay(ms);
+    co_return value;
+}
+
+JS::Promise<void> TestDelayAsync()
+{
+    auto begin = Clock::now();
+    co_await JS::Delay(50);
+    assert(Clock::now() - begin >= 50ms, "resumed too early");
+}
+
+JS::Promise<void> TestWithTimeoutAsync()
+{
+    int value = co_await JS::WithTimeout(ReturnAfterDelayAsync(10, 42), 1000);
+    assert(value == 42, "wrong value");
+    try
+    {
+        co_await JS::WithTimeout(ReturnAfterDelayAsync(100, 0), 10);
+        assert(false, "should have timed out");
+    }
+    catch (const JS::TimeoutError &)
+    {
+    }
+    /** The slow one keeps running, let it finish */
+    co_await JS::Delay(150);
+    co_await JS::WithTimeout(JS::Delay(10), 1000);
+}
+
+JS::Promise<void> TestAsync()
+{
+    RunAsyncTest(TestDelayAsync);
+    RunAsyncTest(TestWithTimeoutAsync);
+}
+
+int main(int argc, char const *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    TestFireOrder();
+    TestFarTimers();
+    TestClearWhileFiring();
+    TestRandomAgainstSorted();
+
+    /** TestAsync sets its first timeout before the loop runs */
+    JS::ScopedTimerWheel timers{loop.Timers()};
+    loop.RunUntilComplete(TestAsync());
+
+    std::cout << "TimerWheel tests completed successfully." << std::endl;
+    return 0;
+}